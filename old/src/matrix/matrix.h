@@ -8,6 +8,9 @@
 #define matrix_h
 
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
 
 #include <ocl_wrapper.h>
 #include <utl_utils.h>
@@ -39,6 +42,15 @@ public:
      */
     Matrix(const Matrix<TYPE> &copy);
     
+    /**
+     * \brief Moveconstructor.
+     *        Takes over the buffer of the argument, so a view returned by
+     *        SubMatrix still shares the buffer of its parent.
+     * 
+     * \param other     The matrix to be moved.
+     */
+    Matrix(Matrix<TYPE> &&other) = default;
+    
     /**
      * \brief Constructor which reserves space in memory for the matrix.
      *        The values will not be initialized!
@@ -58,8 +70,58 @@ public:
      */
     Matrix(const unsigned int rows, const unsigned int cols, const TYPE initval);
     
+    /**
+     * \brief Factory which uploads row-major values from host memory.
+     *        They are written to the device straight from data, so e.g. the
+     *        payload of a memory mapped matrix file (profiling/matfile.h)
+     *        reaches the device without a copy on the host. A named factory
+     *        instead of a constructor, since Matrix(rows, cols, 0) must keep
+     *        selecting the initializing constructor.
+     * 
+     * \param rows      Row count
+     * \param cols      Column count
+     * \param data      Row r starts at data + r * ld
+     * \param ld        Distance of two rows in data, 0 if they are contiguous
+     */
+    static Matrix<TYPE> wrap(const unsigned int rows, const unsigned int cols,
+                             const TYPE *data, const unsigned int ld);
+    
+    /**
+     * \brief Returns a view of a block of this matrix.
+     *        The view shares the device buffer with this matrix, no data is
+     *        copied. Changes to the view are visible in this matrix.
+     * 
+     * \param row       First row of the block
+     * \param col       First column of the block
+     * \param rows      Row count of the block
+     * \param cols      Column count of the block
+     */
+    Matrix<TYPE> SubMatrix(const unsigned int row, const unsigned int col,
+                           const unsigned int rows, const unsigned int cols) const;
+    
+    unsigned int Rows() const { return m_rows; }
+    unsigned int Cols() const { return m_cols; }
+    
+    /**
+     * \brief Index of element (0,0) within the device buffer.
+     */
+    unsigned int Offset() const { return m_offset; }
+    
+    /**
+     * \brief Leading dimension: element (r,c) lies at Offset() + r * Ld() + c
+     *        of the device buffer.
+     */
+    unsigned int Ld() const { return m_ld; }
+    
     //TODO overload operators (don't forget const)
 private:
+    /**
+     * @brief View constructor used by SubMatrix.
+     *        Shares the OCL objects and the buffer of parent.
+     */
+    Matrix(const Matrix<TYPE> &parent, const unsigned int rows,
+           const unsigned int cols, const unsigned int offset);
+
     /**
      * @brief Compiles kernels, gets devices and so on.
      */
@@ -70,6 +132,12 @@ private:
     ocl::Context  m_context;
     ocl::Program  m_program;
     ocl::Queue    m_queue;
+
+    unsigned int  m_rows;
+    unsigned int  m_cols;
+    unsigned int  m_offset;
+    unsigned int  m_ld;
+    std::shared_ptr<ocl::Buffer> m_buffer; //shared by all views of a matrix
 };
 
 //This is where the code lies!
@@ -15,20 +15,97 @@
 
 template <typename TYPE>
 Matrix<TYPE>::Matrix()
+    : m_rows(0), m_cols(0), m_offset(0), m_ld(0)
 {
     PrepareGPU();
 }
 
+template<typename TYPE>
+Matrix<TYPE>::Matrix(const Matrix<TYPE> &copy)
+    : m_platform(copy.m_platform), m_device(copy.m_device),
+      m_context(copy.m_context), m_program(copy.m_program),
+      m_queue(copy.m_queue),
+      m_rows(copy.m_rows), m_cols(copy.m_cols), m_offset(0), m_ld(copy.m_cols)
+{
+    //the OCL objects are shared like in the view constructor, only the
+    //values get a buffer of their own
+    if (m_rows == 0 || m_cols == 0 || !copy.m_buffer)
+    {
+        return;
+    }
+    m_buffer = std::make_shared<ocl::Buffer>(m_context, m_rows*m_cols*sizeof(TYPE));
+
+    //copy is possibly a view, so its rows are gathered one by one into a
+    //contiguous host buffer and uploaded to the new device buffer at once
+    std::vector<TYPE> host(m_rows*m_cols);
+    for (unsigned int r = 0; r < m_rows; ++r)
+    {
+        copy.m_buffer->read(m_queue, (copy.m_offset + r*copy.m_ld)*sizeof(TYPE),
+                            host.data() + r*m_cols, m_cols*sizeof(TYPE));
+    }
+    m_buffer->write(m_queue, 0u, host.data(), m_rows*m_cols*sizeof(TYPE));
+}
+
 template<typename TYPE>
 Matrix<TYPE>::Matrix(const unsigned int rows, const unsigned int cols, const TYPE initval)
+    : m_rows(rows), m_cols(cols), m_offset(0), m_ld(cols)
 {
     PrepareGPU();
     ocl::Kernel& initKernel = m_program.kernel("init", utl::Type::type<TYPE>());
-    initKernel.setWorkSize(16, 16, rows, cols);
+    //init indexes columns with axis 0 and rows with axis 1, so the global
+    //size is (cols, rows) and non-square matrices are covered completely
+    initKernel.setWorkSize(16, 16, cols, rows);
+
+    m_buffer = std::make_shared<ocl::Buffer>(m_context, rows*cols*sizeof(TYPE));
+
+    //enqueue on the queue of this matrix, views share it with their parent
+    initKernel(m_queue, rows, cols, m_buffer->id(), m_offset, m_ld, initval);
+}
+
+template<typename TYPE>
+Matrix<TYPE> Matrix<TYPE>::wrap(const unsigned int rows, const unsigned int cols,
+                                const TYPE *data, const unsigned int ld)
+{
+    Matrix<TYPE> m;
+    m.m_rows = rows;
+    m.m_cols = cols;
+    m.m_ld = cols;
+    m.m_buffer = std::make_shared<ocl::Buffer>(m.m_context, rows*cols*sizeof(TYPE));
 
-    ocl::Buffer b_mat(m_context, rows*cols*sizeof(TYPE));
+    if (ld == 0 || ld == cols)
+    {
+        m.m_buffer->write(m.m_queue, 0u, data, rows*cols*sizeof(TYPE));
+        return m;
+    }
+
+    for (unsigned int r = 0; r < rows; ++r)
+    {
+        m.m_buffer->write(m.m_queue, r*cols*sizeof(TYPE), data + r*ld, cols*sizeof(TYPE));
+    }
+    return m;
+}
 
-    initKernel(int(rows), int(cols), b_mat.id(), initval);
+template<typename TYPE>
+Matrix<TYPE> Matrix<TYPE>::SubMatrix(const unsigned int row, const unsigned int col,
+                                     const unsigned int rows, const unsigned int cols) const
+{
+    if (row + rows > m_rows || col + cols > m_cols)
+    {
+        throw std::out_of_range("SubMatrix exceeds the matrix");
+    }
+
+    return Matrix<TYPE>(*this, rows, cols, m_offset + row * m_ld + col);
+}
+
+template<typename TYPE>
+Matrix<TYPE>::Matrix(const Matrix<TYPE> &parent, const unsigned int rows,
+                     const unsigned int cols, const unsigned int offset)
+    : m_platform(parent.m_platform), m_device(parent.m_device),
+      m_context(parent.m_context), m_program(parent.m_program),
+      m_queue(parent.m_queue),
+      m_rows(rows), m_cols(cols), m_offset(offset), m_ld(parent.m_ld),
+      m_buffer(parent.m_buffer)
+{
 }
 
 template<typename TYPE>
@@ -24,55 +24,57 @@ namespace kernel_strings
 const std::string kernels =
 R"(
 
+// Every matrix argument is a view: element (r,c) lies at off + r*ld + c.
+
 template<class TYPE>
 __kernel void copy(unsigned int rows, unsigned int cols,
-                   __global TYPE *dst, __global TYPE *src)
+                   __global TYPE *dst, unsigned int dOff, unsigned int ldd,
+                   __global TYPE *src, unsigned int sOff, unsigned int lds)
 {
     unsigned int id0 = get_global_id(0);
     unsigned int id1 = get_global_id(1);
 
     if(id0 >= cols || id1 >= rows) return;
 
-    unsigned int index = id0 + id1*cols;
-
-    dst[index] = src[index];
+    dst[dOff + id0 + id1*ldd] = src[sOff + id0 + id1*lds];
 }
 
 template<class TYPE>
 __kernel void init(unsigned int rows, unsigned int cols,
-                   __global TYPE *dst, TYPE initVal)
+                   __global TYPE *dst, unsigned int dOff, unsigned int ldd,
+                   TYPE initVal)
 {
     unsigned int id0 = get_global_id(0);
     unsigned int id1 = get_global_id(1);
 
     if(id0 >= cols || id1 >= rows) return;
 
-    unsigned int index = id0 + id1*cols;
-
-    dst[index] = initVal;
+    dst[dOff + id0 + id1*ldd] = initVal;
 }
 
 template<class TYPE>
 __kernel void multiply(unsigned int n, unsigned int k, unsigned int m,
-                       __global TYPE *dst, __global TYPE *src1, __global TYPE *src2)
+                       __global TYPE *dst,  unsigned int dOff, unsigned int ldd,
+                       __global TYPE *src1, unsigned int off1, unsigned int ld1,
+                       __global TYPE *src2, unsigned int off2, unsigned int ld2)
 {
     unsigned int id0 = get_global_id(0);
     unsigned int id1 = get_global_id(1);
 
     if(id0 >= n || id1 >= m) return;
     
-    unsigned int index1 = id0*k;
+    unsigned int index1 = off1 + id0*ld1;
     unsigned int end = index1 + k;
-    unsigned int index2 = id1;
+    unsigned int index2 = off2 + id1;
     
-    unsigned int dstindex = id0*m+id1;
+    unsigned int dstindex = dOff + id0*ldd + id1;
     TYPE result = 0;
     
     while(index1 < end)
     {
         result += src1[index1] * src2[index2];
         index1++;
-        index2+=m;
+        index2+=ld2;
     }
     
     dst[dstindex] = result;
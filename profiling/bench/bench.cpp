@@ -0,0 +1,82 @@
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <ocl_wrapper.h>
+#include <utl_utils.h>
+
+#include "../roofline.h"
+#include "../verify.h"
+#include "../csr.h"
+#include "../device.h"
+
+
+using Timer = utl::Timer < utl::MilliSeconds >;
+
+
+/*! Measures the peaks of roofline.cl for value type Type on a device. */
+template <class Type>
+void device( DeviceType type, const char* name )
+{
+	ocl::Platform platform( type );
+	ocl::Device   device  = platform.device( type );
+	ocl::Context  context( device );
+	ocl::Queue    queue( context, device, CL_QUEUE_PROFILING_ENABLE );
+
+	const Roofline<Type> roofline( context, queue, type );
+
+	std::cout << name << " " << utl::Type::type<Type>().name()
+			  << ": GB/s=" << roofline.bandwidth() * 1e-9 << ", GFLOP/s=" << roofline.flops() * 1e-9 << std::endl;
+}
+
+
+/*! Measures the host code which runs next to the kernels: the reference product of verify.h and the conversion to Csr. */
+void host( size_t n )
+{
+	using Matrix = utl::Matrix< float, utl::row_major_tag >;
+	using Rand   = utl::Rand  < float, utl::row_major_tag, utl::uniform_dist_tag >;
+
+	const std::vector<double> a( n * n, 0.5 ), b( n * n, 0.25 );
+
+	Timer::tic();
+	const std::vector<double> r = product( a, b, n, n, n );
+	Timer::toc();
+	std::cout << "host reference n=" << n << ": GFLOP/s=" << 2.0 * n * n * n / ( Timer::elapsed().count() * 1e-3 ) * 1e-9
+			  << " (check " << r[0] << ")" << std::endl;
+
+	Matrix dense = Rand( n, n );
+	std::mt19937 gen( 4711 );
+	std::bernoulli_distribution keep( 0.05 );
+	for ( auto& x : dense ) if ( !keep( gen ) ) x = 0;
+
+	Timer::tic();
+	const Csr<float> sparse( dense );
+	Timer::toc();
+	std::cout << "csr conversion n=" << n << ": ms=" << Timer::elapsed().count() << ", nnz=" << sparse.nnz() << std::endl;
+}
+
+
+/*! Micro-benchmarks of the devices and of the host code.
+ *
+ * Usage: bench [n], n is the size of the host benchmarks.
+*/
+int main( int argc, char** argv )
+{
+	utl::Args args( argc, argv );
+
+	size_t const numArgs = args.size();
+
+	if ( numArgs != 1 && numArgs != 2 ) {std::cerr << "Usage: " << args.at( 0 ) << " [n]" << std::endl; return EXIT_FAILURE;}
+
+	size_t const n = numArgs == 2 ? args.toSizet( 1 ) : 1024;
+
+	// Not every system has both device types, e.g. PoCL only provides a CPU device.
+	if ( hasDevice( CL_DEVICE_TYPE_GPU ) ) { device<float> ( ocl::device_type::GPU, "GPU" ); device<double>( ocl::device_type::GPU, "GPU" ); }
+	if ( hasDevice( CL_DEVICE_TYPE_CPU ) ) { device<float> ( ocl::device_type::CPU, "CPU" ); device<double>( ocl::device_type::CPU, "CPU" ); }
+
+	host( n );
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <vector>
+#include <string>
+
+#include <ocl_wrapper.h>
+#include <utl_utils.h>
+
+#include "../profile.h"
+#include "../gemv.h"
+#include "../spmm.h"
+#include "../strassen.h"
+#include "../panel.h"
+#include "../executorpass.h"
+#include "../epilogue.h"
+#include "../generated.h"
+#include "../device.h"
+
+
+/*! Registers every kernel of the profiler for value type Type in testing mode on devices of the given type. */
+template <class Type>
+void registerAll( utl::ProfilePassManager& mgr, DeviceType type, const utl::Dim& first, const utl::Dim& step, const utl::Dim& last )
+{
+	const utl::Dim firstv = utl::Dim( first[0], first[1], 1 );
+	const utl::Dim lastv  = utl::Dim( last[0],  last[1],  1 );
+	const utl::Dim stepv  = utl::Dim( step[0],  step[1],  1 );
+
+	mgr << new StudXPass1<Type,utl::column_major_tag,16u,16u> ("./profile1.cl","multiplycs", first, step, last, true, 1, type);
+	mgr << new StudXPass1<Type,utl::column_major_tag,16u,16u> ("./profile1.cl","multiplyc", first, step, last, true, 1, type);
+	mgr << new StudXPass1<Type,utl::row_major_tag,16u,16u>    ("./profile1.cl","multiplyr", first, step, last, true, 1, type);
+	mgr << new StudXPass1<Type,utl::row_major_tag,16u,16u>    ("./profile1.cl","multiplyr_db", first, step, last, true, 1, type);
+
+	mgr << new GemvPass<Type,utl::row_major_tag,64u,4u,1u>    ("./gemv.cl","matvec2_rmajor", firstv, stepv, lastv, true, 1, type);
+	mgr << new GemvPass<Type,utl::row_major_tag,64u,4u,4u>    ("./gemv.cl","matvec2_rmajor", firstv, stepv, lastv, true, 1, type);
+	mgr << new GemvPass<Type,utl::column_major_tag,64u,4u,1u> ("./gemv.cl","matvec2_cmajor", firstv, stepv, lastv, true, 1, type);
+	mgr << new GemvPass<Type,utl::column_major_tag,64u,4u,4u> ("./gemv.cl","matvec2_cmajor", firstv, stepv, lastv, true, 1, type);
+
+	mgr << new SpmmPass<Type,64u>                             ("./spmm.cl","spmm_csr_rmajor", 0.05, first, step, last, true, 1, type);
+	mgr << new StrassenPass<Type,16u>                         ("./strassen.cl", 1, 32, first, step, last, true, 1, type);
+	if ( first[2] % 64 == 0 && step[2] % 64 == 0 )
+		mgr << new PanelPass<Type,16u,64u,16u>                ("./view.cl", first, step, last, true, 1, type);
+	mgr << new ExecutorPass<Type,16u>                         ("./executor.cl", type, 4, 4, 2, first, step, last, true, 1);
+
+	for ( bool store : { true, false } )
+		for ( const Epilogue& epilogue : { Epilogue::rowSums(), Epilogue::rowNorms(), Epilogue::colMax(), Epilogue::frobenius() } )
+			mgr << new EpiloguePass<Type,16u>                 ("./epilogue.cl", epilogue, store, first, step, last, true, 1, type);
+
+	for ( const char* spec : { "name=gen", "name=gen,TM=32,TN=32,TK=8,VW=4,edge=exact",
+							   "name=gen,layoutA=col,transB=1,layoutC=col,output=alphabeta" } )
+		mgr << new GeneratedPass<Type>                        ( KernelSpec::parse( spec ), first, step, last, true, 1, type );
+}
+
+
+/*! Runs all kernels in testing mode for float and double and fails if any check fails.
+ *
+ * Usage: check [--device gpu|cpu] [dimStart dimEnd dimStep], the dimensions must be multiples of 64.
+ * Without --device the GPU is used if there is one, otherwise the CPU, e.g. with PoCL.
+*/
+int main( int argc, char** argv )
+{
+	// The device option is taken out before the positional arguments are handed to utl::Args.
+	std::vector<char*> positional;
+	std::string device;
+	for ( int i = 0; i < argc; ++i )
+	{
+		const std::string arg = argv[i];
+		if ( arg == "--device" && i + 1 < argc ) { device = argv[++i]; continue; }
+		positional.push_back( argv[i] );
+	}
+
+	utl::Args args( int( positional.size() ), positional.data() );
+
+	size_t const numArgs = args.size();
+
+	if ( ( numArgs != 1 && numArgs != 4 ) || ( !device.empty() && device != "gpu" && device != "cpu" ) )
+	{
+		std::cerr << "Usage: " << args.at( 0 ) << " [--device gpu|cpu] [dimStart dimEnd dimStep]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if ( device.empty() ) device = hasDevice( CL_DEVICE_TYPE_GPU ) ? "gpu" : "cpu";
+	if ( !hasDevice( device == "gpu" ? CL_DEVICE_TYPE_GPU : CL_DEVICE_TYPE_CPU ) ) {std::cerr << "No OpenCL " << device << " device found" << std::endl; return EXIT_FAILURE;}
+	const DeviceType type = device == "gpu" ? ocl::device_type::GPU : ocl::device_type::CPU;
+
+	size_t const f = numArgs == 4 ? args.toSizet( 1 ) : 64;
+	size_t const l = numArgs == 4 ? args.toSizet( 2 ) : 128;
+	size_t const s = numArgs == 4 ? args.toSizet( 3 ) : 64;
+
+	std::cout << "Checking on the " << device << " device" << std::endl;
+
+	utl::ProfilePassManager mgr;
+
+	registerAll<float> ( mgr, type, utl::Dim(f,f,f), utl::Dim(s,s,s), utl::Dim(l,l,l) );
+	registerAll<double>( mgr, type, utl::Dim(f,f,f), utl::Dim(s,s,s), utl::Dim(l,l,l) );
+
+	mgr.run();
+
+	const size_t failed = failedChecks();
+	std::cout << ( failed ? "FAILED" : "passed" ) << ": " << failed << " failed checks" << std::endl;
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#ifndef CSR_H
+#define CSR_H
+
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+
+#include <utl_utils.h>
+
+
+/*! Compressed sparse row storage of a matrix.
+ *
+ * Row m holds the entries values[rowPtr[m]] ... values[rowPtr[m+1]-1] with their
+ * column indices in colIdx. The footprint is proportional to the number of
+ * nonzeros instead of rows*cols, so uploading a Csr only moves nnz elements.
+ *
+ * \param Type_ is the value type of the matrix. Here we use float,double or int.
+*/
+template <class Type_>
+class Csr
+{
+public :
+	using Type  = Type_;
+	using Index = unsigned int;
+
+	Csr() : rows_(0), cols_(0), rowPtr_(1, 0) {}
+	Csr(const Csr&) = default;
+	Csr(Csr&&) = default;
+	Csr& operator=(const Csr&) = default;
+	Csr& operator=(Csr&&) = default;
+	~Csr() = default;
+
+	/*! Converts a dense matrix. Entries which compare equal to zero are dropped. */
+	template <class Format>
+	explicit Csr(const utl::Matrix<Type, Format>& dense);
+
+	size_t rows() const { return rows_; }
+	size_t cols() const { return cols_; }
+	size_t nnz()  const { return values_.size(); }
+
+	/*! Ratio of nonzeros to rows*cols. */
+	double density() const { return rows_ * cols_ == 0 ? 0.0 : double( nnz() ) / double( rows_ * cols_ ); }
+
+	const Index* rowPtr() const { return rowPtr_.data(); }
+	const Index* colIdx() const { return colIdx_.data(); }
+	const Type*  values() const { return values_.data(); }
+
+	size_t rowPtrBytes() const { return sizeof (Index) * rowPtr_.size(); }
+	size_t colIdxBytes() const { return sizeof (Index) * colIdx_.size(); }
+	size_t valuesBytes() const { return sizeof (Type)  * values_.size(); }
+
+	/*! Total number of bytes of the three arrays. */
+	size_t bytes() const { return rowPtrBytes() + colIdxBytes() + valuesBytes(); }
+
+private :
+	size_t rows_;
+	size_t cols_;
+	std::vector<Index> rowPtr_;
+	std::vector<Index> colIdx_;
+	std::vector<Type>  values_;
+};
+
+
+template <class Type_>
+template <class Format>
+Csr<Type_>::Csr(const utl::Matrix<Type, Format>& dense) :
+	rows_( dense.rows() ),
+	cols_( dense.cols() ),
+	rowPtr_( 1, 0 )
+{
+	constexpr bool rowMajor = std::is_same<Format, utl::row_major_tag>::value;
+
+	if ( rows_ * cols_ >= size_t( Index( -1 ) ) ) { throw std::runtime_error( "matrix too large for 32 bit indices" ); }
+
+	rowPtr_.reserve( rows_ + 1 );
+
+	const Type* data = dense.data();
+	for ( size_t m = 0; m < rows_; ++m )
+	{
+		for ( size_t k = 0; k < cols_; ++k )
+		{
+			const Type x = data[rowMajor ? m * cols_ + k : k * rows_ + m];
+			if ( x == Type( 0 ) ) continue;
+			colIdx_.push_back( Index( k ) );
+			values_.push_back( x );
+		}
+		rowPtr_.push_back( Index( values_.size() ) );
+	}
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <vector>
+#include <cstddef>
+
+#include <ocl_wrapper.h>
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/opencl.h>
+#endif
+
+
+/*! Device type of the wrapper, e.g. ocl::device_type::GPU. */
+using DeviceType = decltype( ocl::device_type::GPU );
+
+
+/*! True if any platform offers a device of the given type, e.g. CL_DEVICE_TYPE_CPU.
+ *
+ * Passes select the first device of their type in the constructor, which throws if there
+ * is none. So drivers check the device types first, e.g. PoCL only offers CPU devices.
+*/
+inline bool hasDevice( cl_device_type type )
+{
+	cl_uint numPlatforms = 0;
+	if ( clGetPlatformIDs( 0, nullptr, &numPlatforms ) != CL_SUCCESS || numPlatforms == 0 ) return false;
+
+	std::vector<cl_platform_id> platforms( numPlatforms );
+	if ( clGetPlatformIDs( numPlatforms, platforms.data(), nullptr ) != CL_SUCCESS ) return false;
+
+	for ( cl_platform_id platform : platforms )
+	{
+		cl_uint numDevices = 0;
+		if ( clGetDeviceIDs( platform, type, 0, nullptr, &numDevices ) == CL_SUCCESS && numDevices > 0 ) return true;
+	}
+	return false;
+}
+
+
+/*! Size of the global memory of a device in bytes, 0 if it cannot be queried. */
+inline size_t globalMemSize( ocl::Device& device )
+{
+	cl_ulong bytes = 0;
+	if ( clGetDeviceInfo( device.id(), CL_DEVICE_GLOBAL_MEM_SIZE, sizeof bytes, &bytes, nullptr ) != CL_SUCCESS ) return 0;
+	return size_t( bytes );
+}
+
+
+/*! Maximal number of work-items in a work-group of a device, 0 if it cannot be queried. */
+inline size_t maxWorkGroupSize( ocl::Device& device )
+{
+	size_t size = 0;
+	if ( clGetDeviceInfo( device.id(), CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof size, &size, nullptr ) != CL_SUCCESS ) return 0;
+	return size;
+}
+
+
+/*! Device of a queue, which identifies the device across contexts, nullptr if it cannot be queried. */
+inline cl_device_id deviceOf( ocl::Queue& queue )
+{
+	cl_device_id device = nullptr;
+	if ( clGetCommandQueueInfo( queue.id(), CL_QUEUE_DEVICE, sizeof device, &device, nullptr ) != CL_SUCCESS ) return nullptr;
+	return device;
+}
+
+#endif
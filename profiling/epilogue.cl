@@ -0,0 +1,142 @@
+
+// Kernels for the fused reductions of epilogue.h.
+//
+// multiplyr_reduce computes the tile of dst = src1 * src2 like multiplyr and reduces it
+// in local memory before it leaves the work-group. reduce_partials combines the partials
+// of all work-groups. The reduction is selected at compile time:
+//
+// REDUCE 0 sum, 1 max
+// MAP    0 x, 1 x * x, 2 |x|         applied to every element of dst first
+// AXIS   0 one value per row, 1 one value per column, 2 one value for all elements
+// ROOT   1 takes the square root of the combined values, e.g. for norms
+// STORE  0 skips the write of dst, only the reduction is computed
+//
+// The partials are stored as COUNT vectors of LENGTH values, partial p of value i at
+// partial[p * LENGTH + i]. W must be a power of two.
+
+#if REDUCE == 1
+#define COMBINE(a, b) fmax(a, b)
+#else
+#define COMBINE(a, b) ((a) + (b))
+#endif
+
+#if MAP == 1
+#define APPLY(x) ((x) * (x))
+#elif MAP == 2
+#define APPLY(x) fabs(x)
+#else
+#define APPLY(x) (x)
+#endif
+
+#if AXIS == 0
+#define COUNT  (N / W)
+#define LENGTH M
+#elif AXIS == 1
+#define COUNT  (M / W)
+#define LENGTH N
+#else
+#define COUNT  ((M / W) * (N / W))
+#define LENGTH 1
+#endif
+
+
+template<class TYPE>
+__kernel void multiplyr_reduce(__global TYPE *dst, __global TYPE *src1, __global TYPE *src2, __global TYPE *partial)
+{
+    __local TYPE As[W][W];
+    __local TYPE Bs[W][W];
+
+    unsigned int g_col = get_group_id(0);
+    unsigned int g_row = get_group_id(1);
+
+    unsigned int l_col = get_local_id(0);
+    unsigned int l_row = get_local_id(1);
+
+    if(g_col >= N / W || g_row >= M / W || l_col >= W || l_row >= W)
+        return;
+
+    TYPE c_value = 0;
+
+    for (int j = 0; j < (K / W); ++j) {
+        As[l_row][l_col] = src1[(g_row * W + l_row) * K + (j * W + l_col)];
+        Bs[l_row][l_col] = src2[(j * W + l_row) * N + (g_col * W + l_col)];
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int e = 0; e < W; ++e) {
+            c_value += As[l_row][e] * Bs[e][l_col];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+#if STORE
+    dst[(g_row * W + l_row) * N + g_col * W + l_col] = c_value;
+#endif
+
+    // As is not read anymore after the last barrier and holds the mapped tile now.
+    As[l_row][l_col] = APPLY(c_value);
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+#if AXIS != 1
+    for (unsigned int r = W / 2; r > 0; r >>= 1) {
+        if (l_col < r)
+            As[l_row][l_col] = COMBINE(As[l_row][l_col], As[l_row][l_col + r]);
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+#endif
+#if AXIS != 0
+    for (unsigned int r = W / 2; r > 0; r >>= 1) {
+        if (l_row < r)
+            As[l_row][l_col] = COMBINE(As[l_row][l_col], As[l_row + r][l_col]);
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+#endif
+
+#if AXIS == 0
+    if (l_col == 0)
+        partial[g_col * LENGTH + g_row * W + l_row] = As[l_row][0];
+#elif AXIS == 1
+    if (l_row == 0)
+        partial[g_row * LENGTH + g_col * W + l_col] = As[0][l_col];
+#else
+    if (l_row == 0 && l_col == 0)
+        partial[g_row * (N / W) + g_col] = As[0][0];
+#endif
+}
+
+// Work-group i combines the COUNT partials of value i. Its W threads stride over the
+// partials, then the W intermediate values are reduced in local memory. Threads beyond
+// COUNT hold no value, so no neutral element of the reduction is needed.
+template<class TYPE>
+__kernel void reduce_partials(__global TYPE *out, __global TYPE *partial)
+{
+    __local TYPE part[W];
+
+    const size_t i = get_group_id(0);
+    const size_t l = get_local_id(0);
+
+    if(i >= LENGTH) return;
+
+    if(l < COUNT) {
+        TYPE s = partial[l * LENGTH + i];
+        for(size_t p = l + W; p < COUNT; p += W)
+            s = COMBINE(s, partial[p * LENGTH + i]);
+        part[l] = s;
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(size_t r = W / 2; r > 0; r >>= 1)
+    {
+        if(l < r && l + r < COUNT)
+            part[l] = COMBINE(part[l], part[l + r]);
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if(l == 0)
+#if ROOT
+        out[i] = sqrt(part[0]);
+#else
+        out[i] = part[0];
+#endif
+}
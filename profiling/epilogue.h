@@ -0,0 +1,341 @@
+#ifndef EPILOGUEPASS_H
+#define EPILOGUEPASS_H
+
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <istream>
+#include <vector>
+#include <limits>
+#include <utility>
+#include <cmath>
+
+#include <ocl_wrapper.h>
+#include <utl_utils.h>
+
+#include "roofline.h"
+#include "verify.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+/*! Reduction which is fused into the multiplication, out = root( reduce( map( dst ) ) ) along an axis.
+ *
+ * The members correspond to the compile definitions of epilogue.cl.
+*/
+struct Epilogue
+{
+	enum Reduce { Sum, Max };
+	enum Map    { Identity, Square, Abs };
+	enum Axis   { Rows, Cols, All };
+
+	std::string name;
+	Reduce reduce;
+	Map    map;
+	Axis   axis;
+	bool   root;
+
+	static Epilogue rowSums()   { return Epilogue{ "rowsum",    Sum, Identity, Rows, false }; }
+	static Epilogue rowNorms()  { return Epilogue{ "rownorm",   Sum, Square,   Rows, true  }; }
+	static Epilogue colMax()    { return Epilogue{ "colmax",    Max, Identity, Cols, false }; }
+	static Epilogue frobenius() { return Epilogue{ "frobenius", Sum, Square,   All,  true  }; }
+
+	/*! Number of combined values for an M x N result. */
+	size_t length( size_t M, size_t N ) const { return axis == Rows ? M : axis == Cols ? N : 1; }
+
+	/*! Number of partials per value for W x W tiles. */
+	size_t count( size_t M, size_t N, size_t W ) const { return axis == Rows ? N / W : axis == Cols ? M / W : (M / W) * (N / W); }
+};
+
+
+/*! EpiloguePass profiles the multiplication with a fused reduction of epilogue.cl and is managed by the PassManager.
+ *
+ * Every work-group reduces its tile of the result in local memory and writes one partial
+ * per row, per column or per tile. A second kernel combines the partials. With store set
+ * to false the result itself is never written, so only the operands and the partials
+ * cross global memory. Register a pass with and one without store next to StudXPass1 with
+ * multiplyr to see what the separate reduction pass would cost.
+ *
+ * \param Type_ is the value type of the matrices. Here we use float or double.
+ * \param W is the tile size. W must be a power of two.
+*/
+template <class Type_, size_t W>
+class EpiloguePass : public RooflinePass
+{
+	using Base   = RooflinePass;
+	using Type   = Type_;
+	using Format = utl::row_major_tag;
+	using Rand   = utl::Rand  < Type, Format, utl::uniform_dist_tag >;
+	using Zeros  = utl::Zeros < Type, Format >;
+	using Matrix = utl::Matrix< Type, Format >;
+	using Dim    = utl::Dim;
+public :
+
+	EpiloguePass() = delete;
+	EpiloguePass(const EpiloguePass&) = default;
+	EpiloguePass(EpiloguePass&&) = default;
+	~EpiloguePass() = default;
+
+
+	/*! This is the constructor one should use to initialize the platform. */
+	EpiloguePass(const std::string& filename,   /*! Name of the *.cl file */
+				 const Epilogue& epilogue,      /*! Reduction of the result, e.g. Epilogue::rowSums() */
+				 bool store,                    /*! If false, the result is only reduced and not written */
+				 const Dim& start,              /*! First dimension e.g. Dim(128,128,128) with Dim[0]=M, Dim[1]=N, Dim[2]=K, */
+				 const Dim& step,               /*! Step dimension e.g. Dim(32,32,32) such that this pass iterates from first to last dimension */
+				 const Dim& end,                /*! Last dimension e.g. Dim(256,256,256) with Dim[0]=M, Dim[1]=N, Dim[2]=K, */
+				 bool testing = false,          /*! If true, verifies the reduction and the stored result, see verify.h */
+				 size_t iter = 10,              /*! Number of kernel iterations */
+				 DeviceType type = ocl::device_type::GPU); /*! Device type, e.g. ocl::device_type::CPU for PoCL */
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	utl::Seconds prof( Dim const& ) override;
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	double ops( Dim const& ) override;
+
+	/*! Bytes moved by both kernels. */
+	Traffic traffic( Dim const& ) const override;
+
+private :
+
+	std::string name(const Epilogue& epilogue, bool store) const
+	{
+		std::ostringstream oss;
+		oss << "epilogue_" << epilogue.name << "_" << utl::Type::type<Type>().name() <<  "_B" << W << ( store ? "_store" : "_nostore" );
+		return oss.str();
+	}
+
+	/*! Reduces the row-major double reference like the kernels. Returns the values and their scales for the tolerance. */
+	std::pair<std::vector<double>,std::vector<double>> reduce( const std::vector<double>& ref, size_t M, size_t N ) const;
+
+
+	bool testing_;
+	Epilogue epilogue_;
+	bool store_;
+	ocl::Platform platform_; /*! Platform of the device type given to the constructor. Initialized in the constructor */
+	ocl::Device   device_;   /*! The first Device is chosen. Initialized in the constructor */
+	ocl::Context  context_;  /*! Only one Context is created. Initialized in the constructor */
+	ocl::Queue    queue_;    /*! Only one Queue is created with the above Context and Device. Initialized in the constructor */
+	ocl::Program  program_;  /*! Program is created in the constructor but built in the prof() function with dimension parameters.*/
+	ocl::Kernel*  kernel_;   /*! Multiplication with the reduction of the tiles. */
+	ocl::Kernel*  combine_;  /*! Reduction of the partials. */
+	Roofline<Type> roofline_; /*! Peaks of the device. Measured in the constructor */
+};
+
+
+template <class Type_, size_t W>
+EpiloguePass<Type_,W>::EpiloguePass(
+		const std::string& file,
+		const Epilogue& epilogue,
+		bool store,
+		const utl::Dim& start,
+		const utl::Dim& step,
+		const utl::Dim& end,
+		bool testing,
+		size_t iter,
+		DeviceType type) :
+	  Base(this->name(epilogue, store), start, step, end, testing ? 1 : iter),
+	  testing_(testing),
+	  epilogue_(epilogue),
+	  store_(store),
+	  platform_( type ),
+	  device_( platform_.device( type ) ),
+	  context_( device_ ),
+	  queue_( context_, device_, CL_QUEUE_PROFILING_ENABLE ),
+	  program_( context_, utl::type::Single | utl::type::Double ),
+	  kernel_(nullptr),
+	  combine_(nullptr),
+	  roofline_( context_, queue_, type )
+{
+	std::ifstream stream( file );
+	if ( !stream.is_open() ) { throw std::runtime_error("Failed opening file " + file);}
+	program_ << stream;
+
+	kernel_ = &program_.kernel("multiplyr_reduce", utl::Type::type<Type_>());
+	if ( kernel_ == nullptr ) { throw std::runtime_error( "kernel not valid" ); }
+
+	combine_ = &program_.kernel("reduce_partials", utl::Type::type<Type_>());
+	if ( combine_ == nullptr ) { throw std::runtime_error( "kernel not valid" ); }
+}
+
+
+template <class Type_, size_t W>
+std::pair<std::vector<double>,std::vector<double>> EpiloguePass<Type_,W>::reduce( const std::vector<double>& ref, size_t M, size_t N ) const
+{
+	const size_t length = epilogue_.length( M, N );
+
+	std::vector<double> value( length, 0.0 ), scale( length, 0.0 );
+	std::vector<bool> first( length, true );
+
+	for ( size_t i = 0; i < M; ++i )
+		for ( size_t j = 0; j < N; ++j )
+		{
+			const size_t o = epilogue_.axis == Epilogue::Rows ? i : epilogue_.axis == Epilogue::Cols ? j : 0;
+			const double x = ref[i * N + j];
+			const double y = epilogue_.map == Epilogue::Square ? x * x : epilogue_.map == Epilogue::Abs ? std::fabs( x ) : x;
+
+			if ( epilogue_.reduce == Epilogue::Max ) value[o] = first[o] ? y : std::max( value[o], y );
+			else                                     value[o] += y;
+
+			scale[o] = epilogue_.reduce == Epilogue::Max ? std::max( scale[o], std::fabs( y ) ) : scale[o] + std::fabs( y );
+			first[o] = false;
+		}
+
+	if ( epilogue_.root )
+		for ( size_t o = 0; o < length; ++o ) { value[o] = std::sqrt( value[o] ); scale[o] = std::sqrt( scale[o] ); }
+
+	return { value, scale };
+}
+
+
+/*! Profile function of the Pass.
+ *
+ * One iteration launches both kernels. In testing mode the combined values are compared
+ * against the reduction of the double reference. The tolerance grows with K and the
+ * number of reduced elements and is doubled for the square map.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W>
+utl::Seconds EpiloguePass<Type_,W>::prof( utl::Dim const& dim )
+{
+	  const size_t M = dim[0];
+	  const size_t N = dim[1];
+	  const size_t K = dim[2];
+
+	  static_assert(W >= 8 && (W & (W - 1)) == 0, "W is not a power of two >= 8");
+
+	  if( N <= 0 ) throw std::runtime_error( "N should be greater 0." );
+	  if( M <= 0 ) throw std::runtime_error( "M should be greater 0." );
+	  if( M % W || N % W || K % W ) throw std::runtime_error( "M, N and K should be multiples of W." );
+
+	  const size_t length = epilogue_.length( M, N );
+	  const size_t count  = epilogue_.count( M, N, W );
+
+	  std::ostringstream oss;
+	  oss << "-w -Werror" << " -D M=" << M << "u -D N=" << N << "u -D W=" << W << "u -D K=" << K << 'u'
+		  << " -D REDUCE=" << int(epilogue_.reduce) << " -D MAP=" << int(epilogue_.map) << " -D AXIS=" << int(epilogue_.axis)
+		  << " -D ROOT=" << int(epilogue_.root) << " -D STORE=" << int(store_);
+
+	  program_.setCompileOption( ocl::compile_option::FAST_MATH | ocl::compile_option::NO_SIGNED_ZERO | ocl::CompileOption( oss.str() ) );
+	  program_.build();
+	  if ( ! program_.isBuilt() ) { throw std::runtime_error( "program not built" ); }
+	  if ( ! kernel_->created() ) { throw std::runtime_error( "kernel not created" ); }
+	  if ( ! combine_->created() ) { throw std::runtime_error( "kernel not created" ); }
+
+	  // Axis 0 walks the columns of dst, axis 1 its rows.
+	  kernel_->setWorkSize( W, W, N, M );
+	  combine_->setWorkSize( W, length * W );
+
+	  // Without store the kernel still takes a dst argument, which is never written.
+	  const size_t numResBytes = sizeof (Type) * ( store_ ? M * N : 1 );
+	  const size_t numLhsBytes = sizeof (Type) * M * K;
+	  const size_t numRhsBytes = sizeof (Type) * K * N;
+	  const size_t numParBytes = sizeof (Type) * count * length;
+	  const size_t numOutBytes = sizeof (Type) * length;
+
+	  ocl::Buffer bufRes( context_, numResBytes, ocl::Buffer::WriteOnly );
+	  ocl::Buffer bufLhs( context_, numLhsBytes, ocl::Buffer::ReadOnly );
+	  ocl::Buffer bufRhs( context_, numRhsBytes, ocl::Buffer::ReadOnly );
+	  ocl::Buffer bufPar( context_, numParBytes, ocl::Buffer::ReadWrite );
+	  ocl::Buffer bufOut( context_, numOutBytes, ocl::Buffer::WriteOnly );
+
+	  std::cout << "Running kernel with M=" << M << ", N=" << N << ", partials=" << count << "x" << length << ", size[MB]=" << float(numLhsBytes)/float(1<<20) << std::endl;
+
+	  Matrix lhs;
+	  Matrix rhs;
+	  if(testing_){
+		  lhs = Rand (M, K);
+		  rhs = Rand (K, N);
+		  bufLhs.write( queue_, 0u, lhs.data(), numLhsBytes );
+		  bufRhs.write( queue_, 0u, rhs.data(), numRhsBytes );
+	  }
+
+
+	  // Function which repeated iter_ times from the Passmanager.
+	  auto lambda = [](ocl::Kernel& kernel, ocl::Kernel& combine, ocl::Queue& queue, ocl::Buffer& bufRes, const ocl::Buffer& bufLhs, const ocl::Buffer& bufRhs, ocl::Buffer& bufPar, ocl::Buffer& bufOut)
+	  {
+		  kernel( queue, bufRes.id(), bufLhs.id(), bufRhs.id(), bufPar.id() );
+		  combine( queue, bufOut.id(), bufPar.id() );
+		  queue.finish();
+	  };
+
+	  auto t = this->profile(std::bind(lambda, std::ref(*kernel_), std::ref(*combine_), std::ref(queue_), std::ref(bufRes), std::cref(bufLhs), std::cref(bufRhs), std::ref(bufPar), std::ref(bufOut)), dim, roofline_);
+
+	  if( testing_ )
+	  {
+		  std::vector<Type> out( length );
+		  bufOut.read( queue_, 0u, out.data(), numOutBytes );
+
+		  const std::vector<double> ref = reference( lhs.data(), true, rhs.data(), true, M, N, K );
+		  const auto reduced = this->reduce( ref, M, N );
+
+		  const double eps = std::numeric_limits<Type>::epsilon();
+		  const double tol = 4.0 * eps * double( K + M * N / length ) * ( epilogue_.map == Epilogue::Square ? 2.0 : 1.0 );
+		  compare( out.data(), reduced.first, reduced.second, tol ).report( std::cout );
+
+		  if ( store_ )
+		  {
+			  Matrix res = Zeros( M, N );
+			  bufRes.read( queue_, 0u, res.data(), numResBytes );
+			  verify( lhs, rhs, res ).report( std::cout );
+		  }
+	  }
+
+
+	  program_.release();
+
+
+	  return t;
+}
+
+
+/*! Operation count function of the Pass.
+ *
+ * The multiplication plus one operation per element for the map and one for the reduction.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W>
+double EpiloguePass<Type_,W>::ops( utl::Dim const& dim )
+{
+	  size_t const M = dim[0];
+	  size_t const N = dim[1];
+	  size_t const K = dim[2];
+
+	  return double(M) * N * (K + K - 1u) + 2.0 * M * N;
+}
+
+
+/*! Traffic function of the Pass.
+ *
+ * The multiplication is tiled, without the result if it is not stored. Every tile
+ * writes its partials, which the second kernel reads once. A tree reduction over W
+ * values stores W values and reads two and writes one per combination.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W>
+Traffic EpiloguePass<Type_,W>::traffic( utl::Dim const& dim ) const
+{
+	  size_t const M = dim[0];
+	  size_t const N = dim[1];
+	  size_t const K = dim[2];
+
+	  const double s       = sizeof (Type);
+	  const double length  = epilogue_.length( M, N );
+	  const double partial = s * epilogue_.count( M, N, W ) * length;
+	  const double trees   = epilogue_.axis == Epilogue::All ? 2.0 : 1.0;
+	  const double tree    = W + 3.0 * (W - 1);
+
+	  Traffic t = tiledTraffic<Type>( M, N, K, W );
+	  if ( !store_ ) t.writes = 0;
+
+	  t += Traffic( partial, partial + s * length, s * M * N / W * trees * tree + s * length * tree );
+	  return t;
+}
+
+#endif
@@ -0,0 +1,44 @@
+
+// Batched multiplication with run-time dimensions for executor.h.
+//
+// batch jobs of equal shape are packed one after another: job b multiplies the m x k
+// matrix src1 + b*m*k with the k x n matrix src2 + b*k*n into dst + b*m*n. All matrices
+// are stored in row-major format. The rows of every job are padded to a multiple of W
+// in the index space, so a work-group never spans two jobs, and tiles reaching over the
+// matrix edges are filled with zeros. Hence m, n and k are arbitrary.
+template<class TYPE>
+__kernel void multiplyr_batched(unsigned int m, unsigned int n, unsigned int k,
+                                __global TYPE *dst, __global TYPE *src1, __global TYPE *src2)
+{
+    __local TYPE As[W][W];
+    __local TYPE Bs[W][W];
+
+    const unsigned int mp  = (m + W - 1) / W * W;
+    const unsigned int col = get_global_id(0);
+    const unsigned int b   = get_global_id(1) / mp;
+    const unsigned int row = get_global_id(1) % mp;
+
+    const unsigned int l_col = get_local_id(0);
+    const unsigned int l_row = get_local_id(1);
+
+    src1 += b * m * k;
+    src2 += b * k * n;
+    dst  += b * m * n;
+
+    TYPE c_value = 0;
+
+    for (unsigned int j = 0; j < k; j += W) {
+        As[l_row][l_col] = (row < m && j + l_col < k) ? src1[row * k + j + l_col] : 0;
+        Bs[l_row][l_col] = (j + l_row < k && col < n) ? src2[(j + l_row) * n + col] : 0;
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int e = 0; e < W; ++e) {
+            c_value += As[l_row][e] * Bs[e][l_col];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if(row < m && col < n)
+        dst[row * n + col] = c_value;
+}
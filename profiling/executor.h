@@ -0,0 +1,331 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <istream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <algorithm>
+
+#include <ocl_wrapper.h>
+#include <utl_utils.h>
+
+#include "device.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+/*! Executor multiplies row-major matrices asynchronously and may be shared by many threads.
+ *
+ * submit() enqueues a job and returns a future for its result. A fixed pool of worker
+ * threads serves the jobs, each with its own queue, program and kernel on the one device,
+ * so no OpenCL object is used by two threads. A worker takes the oldest job and, if it is
+ * small, up to maxBatch - 1 further pending jobs of the same shape, and multiplies all of
+ * them with one launch of multiplyr_batched.
+ *
+ * The bytes of all jobs which are pending or running are bounded by maxBytes, by default
+ * half of CL_DEVICE_GLOBAL_MEM_SIZE. submit() blocks until enough jobs have finished, so
+ * clients are slowed down instead of the device running out of memory.
+ *
+ * \param Type_ is the value type of the matrices. Here we use float or double.
+ * \param W is the tile size of the kernel.
+*/
+template <class Type_, size_t W>
+class Executor
+{
+	using Type   = Type_;
+	using Format = utl::row_major_tag;
+	using Zeros  = utl::Zeros < Type, Format >;
+public :
+	using Matrix     = utl::Matrix< Type, Format >;
+	using DeviceType = decltype( ocl::device_type::GPU );
+
+	Executor() = delete;
+	Executor(const Executor&) = delete;
+	Executor(Executor&&) = delete;
+	Executor& operator=(const Executor&) = delete;
+
+	/*! Creates the workers and starts their threads. */
+	Executor(const std::string& filename,           /*! Name of the *.cl file containing multiplyr_batched */
+			 DeviceType type,                       /*! Device type, e.g. ocl::device_type::CPU for stress tests */
+			 size_t queues     = 2,                 /*! Number of worker threads, each with its own queue */
+			 size_t maxBytes   = 0,                 /*! Upper bound of the bytes of all pending and running jobs, 0 for half the global memory of the device */
+			 size_t maxBatch   = 16,                /*! Maximal number of jobs per launch */
+			 size_t smallBytes = size_t(1) << 20);  /*! Only jobs up to this size are coalesced */
+
+	/*! Finishes all pending jobs and joins the workers. */
+	~Executor();
+
+	/*! Enqueues lhs * rhs. Blocks while the memory bound would be exceeded.
+	 *
+	 * \throws std::runtime_error if the shapes do not match or the job alone exceeds maxBytes.
+	*/
+	std::future<Matrix> submit( Matrix lhs, Matrix rhs );
+
+	/*! Number of kernel launches so far. */
+	size_t launches() const { return launches_; }
+
+	/*! Number of finished jobs so far. */
+	size_t jobs() const { return jobs_; }
+
+private :
+
+	struct Job
+	{
+		Job(Matrix&& lhs, Matrix&& rhs, size_t bytes) : lhs(std::move(lhs)), rhs(std::move(rhs)), bytes(bytes) {}
+
+		Matrix lhs;
+		Matrix rhs;
+		std::promise<Matrix> result;
+		size_t bytes;
+	};
+
+	struct Worker
+	{
+		Worker(ocl::Context& context, ocl::Device& device, const std::string& source);
+
+		ocl::Queue   queue;
+		ocl::Program program;
+		ocl::Kernel* kernel;
+		std::thread  thread;
+	};
+
+	using Batch = std::vector< std::unique_ptr<Job> >;
+
+	/*! Bytes of the three matrices of a job. */
+	static size_t bytes( const Matrix& lhs, const Matrix& rhs )
+	{
+		return sizeof (Type) * ( lhs.rows() * lhs.cols() + rhs.rows() * rhs.cols() + lhs.rows() * rhs.cols() );
+	}
+
+	static bool same( const Job& a, const Job& b )
+	{
+		return a.lhs.rows() == b.lhs.rows() && a.lhs.cols() == b.lhs.cols() && a.rhs.cols() == b.rhs.cols();
+	}
+
+	/*! Half of the global memory of the device, 256 MB if it cannot be queried. */
+	static size_t defaultBytes( ocl::Device& device )
+	{
+		const size_t bytes = globalMemSize( device ) / 2;
+		return bytes ? bytes : size_t(1) << 28;
+	}
+
+	/*! Loop of a worker thread. */
+	void run( Worker& worker );
+
+	/*! Multiplies all jobs of the batch with one launch and fulfills their promises. */
+	void launch( Worker& worker, Batch& batch );
+
+
+	ocl::Platform platform_;
+	ocl::Device   device_;
+	ocl::Context  context_;
+	size_t maxBytes_;
+	size_t maxBatch_;
+	size_t smallBytes_;
+
+	std::mutex mutex_;              /*! Guards pending_, inFlight_ and stop_ */
+	std::condition_variable work_;  /*! Signalled when a job is pending or the executor stops */
+	std::condition_variable space_; /*! Signalled when inFlight_ shrinks */
+	std::deque< std::unique_ptr<Job> > pending_;
+	size_t inFlight_;
+	bool stop_;
+
+	std::atomic<size_t> launches_;
+	std::atomic<size_t> jobs_;
+	std::vector< std::unique_ptr<Worker> > workers_;
+};
+
+
+template <class Type_, size_t W>
+Executor<Type_,W>::Worker::Worker(ocl::Context& context, ocl::Device& device, const std::string& source) :
+	queue( context, device ),
+	program( context, utl::type::Single | utl::type::Double ),
+	kernel( nullptr ),
+	thread()
+{
+	program << source;
+
+	kernel = &program.kernel("multiplyr_batched", utl::Type::type<Type_>());
+	if ( kernel == nullptr ) { throw std::runtime_error( "kernel not valid" ); }
+
+	std::ostringstream oss;
+	oss << "-w -Werror" << " -D W=" << W << 'u';
+
+	program.setCompileOption( ocl::compile_option::FAST_MATH | ocl::compile_option::NO_SIGNED_ZERO | ocl::CompileOption( oss.str() ) );
+	program.build();
+	if ( ! program.isBuilt() ) { throw std::runtime_error( "program not built" ); }
+	if ( ! kernel->created() ) { throw std::runtime_error( "kernel not created" ); }
+}
+
+
+template <class Type_, size_t W>
+Executor<Type_,W>::Executor(
+		const std::string& file,
+		DeviceType type,
+		size_t queues,
+		size_t maxBytes,
+		size_t maxBatch,
+		size_t smallBytes) :
+	platform_( type ),
+	device_( platform_.device( type ) ),
+	context_( device_ ),
+	maxBytes_( maxBytes ? maxBytes : defaultBytes( device_ ) ),
+	maxBatch_( std::max( maxBatch, size_t(1) ) ),
+	smallBytes_( smallBytes ),
+	inFlight_( 0 ),
+	stop_( false ),
+	launches_( 0 ),
+	jobs_( 0 )
+{
+	std::ifstream stream( file );
+	if ( !stream.is_open() ) { throw std::runtime_error("Failed opening file " + file);}
+	std::stringstream source;
+	source << stream.rdbuf();
+
+	// All programs are built before the first thread starts.
+	for ( size_t i = 0; i < std::max( queues, size_t(1) ); ++i )
+		workers_.emplace_back( new Worker( context_, device_, source.str() ) );
+
+	for ( auto& worker : workers_ )
+		worker->thread = std::thread( &Executor::run, this, std::ref( *worker ) );
+}
+
+
+template <class Type_, size_t W>
+Executor<Type_,W>::~Executor()
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		stop_ = true;
+	}
+	work_.notify_all();
+	space_.notify_all();
+
+	for ( auto& worker : workers_ )
+		if ( worker->thread.joinable() ) worker->thread.join();
+}
+
+
+template <class Type_, size_t W>
+std::future<typename Executor<Type_,W>::Matrix> Executor<Type_,W>::submit( Matrix lhs, Matrix rhs )
+{
+	if ( lhs.cols() != rhs.rows() ) { throw std::runtime_error( "inner dimensions do not match" ); }
+
+	const size_t numBytes = bytes( lhs, rhs );
+	if ( numBytes > maxBytes_ ) { throw std::runtime_error( "job exceeds the memory bound of the executor" ); }
+
+	std::unique_ptr<Job> job( new Job( std::move( lhs ), std::move( rhs ), numBytes ) );
+	std::future<Matrix> future = job->result.get_future();
+
+	{
+		std::unique_lock<std::mutex> lock( mutex_ );
+		space_.wait( lock, [this, numBytes]{ return stop_ || inFlight_ + numBytes <= maxBytes_; } );
+		if ( stop_ ) { throw std::runtime_error( "executor stopped" ); }
+		inFlight_ += numBytes;
+		pending_.push_back( std::move( job ) );
+	}
+	work_.notify_one();
+
+	return future;
+}
+
+
+template <class Type_, size_t W>
+void Executor<Type_,W>::run( Worker& worker )
+{
+	for ( ;; )
+	{
+		Batch batch;
+		{
+			std::unique_lock<std::mutex> lock( mutex_ );
+			work_.wait( lock, [this]{ return stop_ || !pending_.empty(); } );
+			if ( pending_.empty() ) return;
+
+			batch.push_back( std::move( pending_.front() ) );
+			pending_.pop_front();
+
+			if ( batch.front()->bytes <= smallBytes_ )
+			{
+				for ( auto it = pending_.begin(); it != pending_.end() && batch.size() < maxBatch_; )
+				{
+					if ( same( **it, *batch.front() ) ) { batch.push_back( std::move( *it ) ); it = pending_.erase( it ); }
+					else ++it;
+				}
+			}
+		}
+
+		size_t numBytes = 0;
+		for ( auto& job : batch ) numBytes += job->bytes;
+
+		try
+		{
+			this->launch( worker, batch );
+		}
+		catch ( ... )
+		{
+			for ( auto& job : batch ) job->result.set_exception( std::current_exception() );
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( mutex_ );
+			inFlight_ -= numBytes;
+		}
+		space_.notify_all();
+	}
+}
+
+
+template <class Type_, size_t W>
+void Executor<Type_,W>::launch( Worker& worker, Batch& batch )
+{
+	const size_t M = batch.front()->lhs.rows();
+	const size_t K = batch.front()->lhs.cols();
+	const size_t N = batch.front()->rhs.cols();
+	const size_t count = batch.size();
+
+	const size_t numResBytes = sizeof (Type) * M * N;
+	const size_t numLhsBytes = sizeof (Type) * M * K;
+	const size_t numRhsBytes = sizeof (Type) * K * N;
+
+	ocl::Buffer bufRes( context_, count * numResBytes, ocl::Buffer::WriteOnly );
+	ocl::Buffer bufLhs( context_, count * numLhsBytes, ocl::Buffer::ReadOnly );
+	ocl::Buffer bufRhs( context_, count * numRhsBytes, ocl::Buffer::ReadOnly );
+
+	for ( size_t i = 0; i < count; ++i )
+	{
+		bufLhs.write( worker.queue, i * numLhsBytes, batch[i]->lhs.data(), numLhsBytes );
+		bufRhs.write( worker.queue, i * numRhsBytes, batch[i]->rhs.data(), numRhsBytes );
+	}
+
+	worker.kernel->setWorkSize( W, W, (N + W - 1) / W * W, count * ((M + W - 1) / W * W) );
+	(*worker.kernel)( worker.queue, unsigned(M), unsigned(N), unsigned(K), bufRes.id(), bufLhs.id(), bufRhs.id() );
+
+	std::vector<Matrix> results;
+	results.reserve( count );
+	for ( size_t i = 0; i < count; ++i )
+	{
+		results.push_back( Zeros( M, N ) );
+		bufRes.read( worker.queue, i * numResBytes, results.back().data(), numResBytes );
+	}
+	worker.queue.finish();
+
+	++launches_;
+	jobs_ += count;
+
+	for ( size_t i = 0; i < count; ++i )
+		batch[i]->result.set_value( std::move( results[i] ) );
+}
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef EXECUTORPASS_H
+#define EXECUTORPASS_H
+
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <future>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <string>
+
+#include <ocl_wrapper.h>
+#include <utl_utils.h>
+
+#include "executor.h"
+#include "roofline.h"
+#include "verify.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+/*! ExecutorPass stresses one shared Executor with many client threads and is managed by the PassManager.
+ *
+ * Every client submits jobs jobs before it waits for the first result. Even clients
+ * multiply M x K by K x N matrices, odd clients matrices of half the size, so the
+ * workers see interleaved shapes to coalesce. The pass reports how many jobs were
+ * coalesced per launch. Use a CPU device for stress tests.
+ *
+ * \param Type_ is the value type of the matrices. Here we use float or double.
+ * \param W is the tile size of the kernel.
+*/
+template <class Type_, size_t W>
+class ExecutorPass : public RooflinePass
+{
+	using Base     = RooflinePass;
+	using Type     = Type_;
+	using Format   = utl::row_major_tag;
+	using Zeros    = utl::Zeros < Type, Format >;
+	using Matrix   = utl::Matrix< Type, Format >;
+	using Dim      = utl::Dim;
+	using Executor = ::Executor< Type, W >;
+public :
+
+	ExecutorPass() = delete;
+	ExecutorPass(const ExecutorPass&) = delete;
+	~ExecutorPass() = default;
+
+
+	/*! This is the constructor one should use to initialize the executor. */
+	ExecutorPass(const std::string& filename,                 /*! Name of the *.cl file */
+				 typename Executor::DeviceType type,          /*! Device type, e.g. ocl::device_type::CPU */
+				 size_t clients,                              /*! Number of client threads */
+				 size_t jobs,                                 /*! Number of jobs per client */
+				 size_t queues,                               /*! Number of worker queues of the executor */
+				 const Dim& start,                            /*! First dimension e.g. Dim(32,32,32) with Dim[0]=M, Dim[1]=N, Dim[2]=K, */
+				 const Dim& step,                             /*! Step dimension e.g. Dim(32,32,32) such that this pass iterates from first to last dimension */
+				 const Dim& end,                              /*! Last dimension e.g. Dim(256,256,256) with Dim[0]=M, Dim[1]=N, Dim[2]=K, */
+				 bool testing = false,                        /*! If true, verifies every result, see verify.h */
+				 size_t iter = 10);                           /*! Number of iterations */
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	utl::Seconds prof( Dim const& ) override;
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	double ops( Dim const& ) override;
+
+	/*! Bytes moved by all jobs, each as a tiled product of padded dimensions. */
+	Traffic traffic( Dim const& ) const override;
+
+private :
+
+	std::string name(size_t clients, size_t jobs, size_t queues) const
+	{
+		std::ostringstream oss;
+		oss << "executor_" << utl::Type::type<Type>().name() <<  "_B" << W << "_C" << clients << "_J" << jobs << "_Q" << queues;
+		return oss.str();
+	}
+
+	/*! Shape of the jobs of client c: Dim(M,N,K) for even clients, half of it for odd ones. */
+	static Dim shape( Dim const& dim, size_t c )
+	{
+		if ( c % 2 == 0 ) return dim;
+		return Dim( std::max<size_t>( dim[0] / 2, 1 ), std::max<size_t>( dim[1] / 2, 1 ), std::max<size_t>( dim[2] / 2, 1 ) );
+	}
+
+	/*! Random rows x cols matrix from the given generator. */
+	static Matrix random( size_t rows, size_t cols, std::mt19937& gen )
+	{
+		std::uniform_real_distribution<double> dist( -1.0, 1.0 );
+		Matrix m = Zeros( rows, cols );
+		for ( size_t i = 0; i < rows * cols; ++i ) m.data()[i] = Type( dist( gen ) );
+		return m;
+	}
+
+	/*! Submits and collects the jobs of client c. Verifies every result in testing mode. */
+	Verification client( Dim const& dim, size_t c );
+
+
+	size_t clients_;
+	size_t jobs_;
+	bool testing_;
+	std::unique_ptr<Executor> executor_;
+	ocl::Platform platform_; /*! Platform of the device type of the executor, used for the peaks only */
+	ocl::Device   device_;
+	ocl::Context  context_;
+	ocl::Queue    queue_;
+	Roofline<Type> roofline_; /*! Peaks of the device. Measured in the constructor */
+};
+
+
+template <class Type_, size_t W>
+ExecutorPass<Type_,W>::ExecutorPass(
+		const std::string& file,
+		typename Executor::DeviceType type,
+		size_t clients,
+		size_t jobs,
+		size_t queues,
+		const utl::Dim& start,
+		const utl::Dim& step,
+		const utl::Dim& end,
+		bool testing,
+		size_t iter) :
+	  Base(this->name(clients, jobs, queues), start, step, end, testing ? 1 : iter),
+	  clients_(clients),
+	  jobs_(jobs),
+	  testing_(testing),
+	  executor_( new Executor( file, type, queues ) ),
+	  platform_( type ),
+	  device_( platform_.device( type ) ),
+	  context_( device_ ),
+	  queue_( context_, device_ ),
+	  roofline_( context_, queue_, type )
+{
+}
+
+
+template <class Type_, size_t W>
+Verification ExecutorPass<Type_,W>::client( utl::Dim const& dim, size_t c )
+{
+	const Dim s = shape( dim, c );
+	std::mt19937 gen( 4711 + c );
+
+	std::vector<Matrix> lhs, rhs;
+	std::vector< std::future<Matrix> > results;
+	for ( size_t j = 0; j < jobs_; ++j )
+	{
+		lhs.push_back( random( s[0], s[2], gen ) );
+		rhs.push_back( random( s[2], s[1], gen ) );
+		results.push_back( executor_->submit( lhs.back(), rhs.back() ) );
+	}
+
+	Verification v;
+	for ( size_t j = 0; j < jobs_; ++j )
+	{
+		const Matrix res = results[j].get();
+		if ( testing_ ) v += verify( lhs[j], rhs[j], res );
+	}
+	return v;
+}
+
+
+/*! Profile function of the Pass.
+ *
+ * The measured time spans from the first submit to the last result of all clients.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W>
+utl::Seconds ExecutorPass<Type_,W>::prof( utl::Dim const& dim )
+{
+	  if( dim[0] <= 0 || dim[1] <= 0 || dim[2] <= 0 ) throw std::runtime_error( "M, N and K should be greater 0." );
+
+	  std::cout << "Running " << clients_ << " clients with " << jobs_ << " jobs each, M=" << dim[0] << ", N=" << dim[1] << ", K=" << dim[2] << std::endl;
+
+	  const size_t launches = executor_->launches();
+	  const size_t jobs     = executor_->jobs();
+
+	  std::vector<Verification> checks( clients_ );
+	  std::vector<std::string> errors( clients_ );
+
+	  // Function which repeated iter_ times from the Passmanager. An exception of a client,
+	  // e.g. from submit() or a result, must not leave its thread, so it is kept as error.
+	  auto lambda = [this, &dim, &checks, &errors]()
+	  {
+		  std::vector<std::thread> threads;
+		  for ( size_t c = 0; c < clients_; ++c )
+			  threads.emplace_back( [this, &dim, &checks, &errors, c]()
+			  {
+				  try { checks[c] += this->client( dim, c ); }
+				  catch ( const std::exception& e ) { if ( errors[c].empty() ) errors[c] = e.what(); }
+				  catch ( ... ) { if ( errors[c].empty() ) errors[c] = "unknown exception"; }
+			  } );
+		  for ( auto& thread : threads ) thread.join();
+	  };
+
+	  auto t = this->profile( lambda, dim, roofline_ );
+
+	  const size_t numJobs = executor_->jobs() - jobs;
+	  const size_t numLaunches = executor_->launches() - launches;
+	  std::cout << "Jobs per launch: " << double( numJobs ) / double( std::max<size_t>( numLaunches, 1 ) ) << std::endl;
+
+	  for ( size_t c = 0; c < clients_; ++c )
+	  {
+		  if ( errors[c].empty() ) continue;
+		  std::cout << "Client " << c << " FAILED: " << errors[c] << std::endl;
+		  ++failedChecks();
+	  }
+
+	  if( testing_ )
+	  {
+		  Verification v;
+		  for ( auto const& check : checks ) v += check;
+		  v.report( std::cout );
+	  }
+
+	  return t;
+}
+
+
+/*! Operation count function of the Pass.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W>
+double ExecutorPass<Type_,W>::ops( utl::Dim const& dim )
+{
+	  double sum = 0;
+	  for ( size_t c = 0; c < clients_; ++c )
+	  {
+		  const Dim s = shape( dim, c );
+		  sum += double( jobs_ ) * s[0] * s[1] * (s[2] + s[2] - 1u);
+	  }
+	  return sum;
+}
+
+
+/*! Traffic function of the Pass.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W>
+Traffic ExecutorPass<Type_,W>::traffic( utl::Dim const& dim ) const
+{
+	  auto const pad = []( size_t x ) { return (x + W - 1) / W * W; };
+
+	  Traffic sum;
+	  for ( size_t c = 0; c < clients_; ++c )
+	  {
+		  const Dim s = shape( dim, c );
+		  sum += tiledTraffic<Type>( pad( s[0] ), pad( s[1] ), pad( s[2] ), W ) * double( jobs_ );
+	  }
+	  return sum;
+}
+
+#endif
@@ -0,0 +1,89 @@
+
+// c Zeros( M, NV );
+// A Rand ( M, N );
+// b Rand ( N, NV );
+//
+// The NV right-hand sides are stored one after another: vector v starts at b + v*N,
+// its result starts at c + v*M. With NV = 1 this is a plain matrix-vector product.
+
+
+// Work-group m is responsible to calculate the NV inner products of row m of A.
+// Its W threads stride over the row, so thread l, thread l+1 address contiguous
+// row elements of A -> coalesced memory access. The W partial sums per right-hand
+// side are then reduced in local memory. W must be a power of two.
+template<class Type>
+__kernel void matvec2_rmajor(__global Type *c, __global Type *A, __global Type *b)
+{
+	__local Type part[NV][W];
+
+	const size_t m = get_group_id(0);
+	const size_t l = get_local_id(0);
+
+	if(m >= M) return;
+
+	__global Type* a = A + m*N;
+
+	Type s[NV];
+	for(size_t v = 0; v < NV; ++v)
+		s[v] = 0;
+
+	for(size_t n = l; n < N; n += W)
+	{
+		const Type x = a[n];
+		for(size_t v = 0; v < NV; ++v)
+			s[v] += x * b[v*N + n];
+	}
+
+	for(size_t v = 0; v < NV; ++v)
+		part[v][l] = s[v];
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for(size_t r = W/2; r > 0; r >>= 1)
+	{
+		if(l < r)
+			for(size_t v = 0; v < NV; ++v)
+				part[v][l] += part[v][l + r];
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if(l < NV)
+		c[l*M + m] = part[l][0];
+}
+
+// Thread m is responsible to calculate the inner products of VW consecutive rows.
+// The VW rows of one column are contiguous, so each thread sweeps the columns with
+// VW-wide loads which the compiler maps onto vector loads, and neighbouring threads
+// still address contiguous column elements of A. M must be a multiple of VW.
+template<class Type>
+__kernel void matvec2_cmajor(__global Type *c, __global Type *A, __global Type *b)
+{
+	const size_t m = get_global_id(0) * VW;
+
+	if(m >= M) return;
+
+	__global Type* a = A + m;
+
+	Type s[NV][VW];
+	for(size_t v = 0; v < NV; ++v)
+		for(size_t i = 0; i < VW; ++i)
+			s[v][i] = 0;
+
+	for(size_t n = 0; n < N; ++n)
+	{
+		Type x[VW];
+		for(size_t i = 0; i < VW; ++i)
+			x[i] = a[n*M + i];
+
+		for(size_t v = 0; v < NV; ++v)
+		{
+			const Type y = b[v*N + n];
+			for(size_t i = 0; i < VW; ++i)
+				s[v][i] += x[i] * y;
+		}
+	}
+
+	for(size_t v = 0; v < NV; ++v)
+		for(size_t i = 0; i < VW; ++i)
+			c[v*M + m + i] = s[v][i];
+}
@@ -0,0 +1,241 @@
+#ifndef GEMVPASS_H
+#define GEMVPASS_H
+
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <istream>
+#include <type_traits>
+#include <vector>
+#include <cmath>
+
+#include <ocl_wrapper.h>
+#include <utl_utils.h>
+
+#include "roofline.h"
+#include "verify.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+/*! GemvPass profiles the matrix-vector kernels of gemv.cl and is managed by the PassManager.
+ *
+ * Matrix-vector products are memory-bound, so the roofline report of the pass sets the
+ * achieved bandwidth in GB/s in relation to the peak bandwidth of the device.
+ *
+ * \param Type_ is the value type of the matrices. Here we use float,double or int. other types are also possible
+ * \param Format_ is the storage type of the matrix. Use matvec2_rmajor for row-major and matvec2_cmajor for column-major format.
+ * \param W is the work-group size. Must be a power of two for matvec2_rmajor.
+ * \param VW is the number of rows computed by one thread of matvec2_cmajor. M must be a multiple of VW.
+ * \param NV is the number of right-hand sides multiplied in one launch.
+*/
+template <class Type_,class Format_ , size_t W, size_t VW, size_t NV>
+class GemvPass : public RooflinePass
+{
+	using Base   = RooflinePass;
+	using Type   = Type_;
+	using Format = Format_;
+	using Rand   = utl::Rand  < Type, Format, utl::uniform_dist_tag >;
+	using Matrix = utl::Matrix< Type, Format >;
+	using Dim    = utl::Dim;
+public :
+
+	GemvPass() = delete;
+	GemvPass(const GemvPass&) = default;
+	GemvPass(GemvPass&&) = default;
+	~GemvPass() = default;
+
+
+	/*! This is the constructor one should use to initialize the platform. */
+	GemvPass(const std::string& filename,   /*! Name of the *.cl file */
+			 const std::string& kernelname, /*! Kernel name within the *.cl file */
+			 const Dim& start,              /*! First dimension e.g. Dim(128,128,1) with Dim[0]=M, Dim[1]=N. Dim[2] is ignored */
+			 const Dim& step,               /*! Step dimension e.g. Dim(32,32,1) such that this pass iterates from first to last dimension */
+			 const Dim& end,                /*! Last dimension e.g. Dim(256,256,1) with Dim[0]=M, Dim[1]=N. Dim[2] is ignored */
+			 bool testing = false,          /*! If true, verifies the gpu result, see verify.h */
+			 size_t iter = 10,              /*! Number of kernel iterations */
+			 DeviceType type = ocl::device_type::GPU); /*! Device type, e.g. ocl::device_type::CPU for PoCL */
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	utl::Seconds prof( Dim const& ) override;
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	double ops( Dim const& ) override;
+
+	/*! Bytes moved by the kernel. */
+	Traffic traffic( Dim const& ) const override;
+
+private :
+
+	std::string name(const std::string& kernel) const
+	{
+		std::ostringstream oss;
+		oss << "gemv_" << kernel << "_" << utl::Type::type<Type>().name() <<  "_W" << W << "_VW" << VW << "_NV" << NV;
+		return oss.str();
+	}
+
+
+	bool testing_;
+	ocl::Platform platform_; /*! Platform of the device type given to the constructor. Initialized in the constructor */
+	ocl::Device   device_;   /*! The first Device is chosen. Initialized in the constructor */
+	ocl::Context  context_;  /*! Only one Context is created. Initialized in the constructor */
+	ocl::Queue    queue_;    /*! Only one Queue is created with the above Context and Device. Initialized in the constructor */
+	ocl::Program  program_;  /*! Program is created in the constructor but built in the prof() function with dimension parameters.*/
+	ocl::Kernel*  kernel_;   /*! Kernel is created in the constructor but built in the prof() function. */
+	Roofline<Type> roofline_; /*! Peaks of the device. Measured in the constructor */
+};
+
+
+template <class Type_,class Format_, size_t W, size_t VW, size_t NV>
+GemvPass<Type_,Format_,W,VW,NV>::GemvPass(
+		const std::string& file,
+		const std::string& kernel,
+		const utl::Dim& start,
+		const utl::Dim& step,
+		const utl::Dim& end,
+		bool testing,
+		size_t iter,
+		DeviceType type) :
+	  Base(this->name(kernel), start, step, end, testing ? 1 : iter),
+	  testing_(testing),
+	  platform_( type ),
+	  device_( platform_.device( type ) ),
+	  context_( device_ ),
+	  queue_( context_, device_, CL_QUEUE_PROFILING_ENABLE ),
+	  program_( context_, utl::type::Single | utl::type::Double ),
+	  kernel_(nullptr),
+	  roofline_( context_, queue_, type )
+{
+	std::ifstream stream( file );
+	if ( !stream.is_open() ) { throw std::runtime_error("Failed opening file " + file);}
+	program_ << stream;
+
+	kernel_ = &program_.kernel(kernel, utl::Type::type<Type_>());
+	if ( kernel_ == nullptr ) { throw std::runtime_error( "kernel not valid" ); }
+}
+
+
+/*! Profile function of the Pass.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_,class Format_ , size_t W, size_t VW, size_t NV>
+utl::Seconds GemvPass<Type_,Format_,W,VW,NV>::prof( utl::Dim const& dim )
+{
+	  const size_t M = dim[0];
+	  const size_t N = dim[1];
+
+	  constexpr bool rowMajor = std::is_same<Format, utl::row_major_tag>::value;
+
+	  static_assert((W & (W - 1)) == 0, "W must be a power of two");
+	  static_assert(NV <= W, "NV > W");
+
+	  if( N <= 0 ) throw std::runtime_error( "N should be greater 0." );
+	  if( M <= 0 ) throw std::runtime_error( "M should be greater 0." );
+	  if( M % VW ) throw std::runtime_error( "M should be a multiple of VW." );
+
+	  std::ostringstream oss;
+	  oss << "-w -Werror" << " -D M=" << M << "u -D N=" << N << "u -D W=" << W << "u -D VW=" << VW << "u -D NV=" << NV << 'u';
+
+	  program_.setCompileOption( ocl::compile_option::FAST_MATH | ocl::compile_option::NO_SIGNED_ZERO | ocl::CompileOption( oss.str() ) );
+	  program_.build();
+	  if ( ! program_.isBuilt() ) { throw std::runtime_error( "program not built" ); }
+	  if ( ! kernel_->created() ) { throw std::runtime_error( "kernel not created" ); }
+
+	  // Row-major: one work-group per row. Column-major: one thread per VW rows, rounded up to
+	  // whole work-groups, the padding threads return at the m >= M guard of the kernel.
+	  if( rowMajor ) kernel_->setWorkSize( W, M * W );
+	  else           kernel_->setWorkSize( W, (M / VW + W - 1) / W * W );
+
+	  const size_t numResBytes = sizeof (Type) * M * NV;
+	  const size_t numLhsBytes = sizeof (Type) * M * N;
+	  const size_t numRhsBytes = sizeof (Type) * N * NV;
+
+	  ocl::Buffer bufRes( context_, numResBytes, ocl::Buffer::WriteOnly );
+	  ocl::Buffer bufLhs( context_, numLhsBytes, ocl::Buffer::ReadOnly );
+	  ocl::Buffer bufRhs( context_, numRhsBytes, ocl::Buffer::ReadOnly );
+
+	  std::cout << "Running kernel with M=" << M << ", N=" << N << ", NV=" << NV << ", size[MB]=" << float(numLhsBytes)/float(1<<20) << std::endl;
+
+	  Matrix lhs;
+	  std::vector<Type> rhs;
+	  if(testing_){
+		  lhs = Rand (M, N);
+		  rhs.resize( N * NV );
+		  for ( size_t i = 0; i < N * NV; ++i ) rhs[i] = Type( i % 7 ) - Type( 3 );
+		  bufLhs.write( queue_, 0u, lhs.data(), numLhsBytes );
+		  bufRhs.write( queue_, 0u, rhs.data(), numRhsBytes );
+	  }
+
+
+	  // Function which repeated iter_ times from the Passmanager.
+	  auto lambda = [](ocl::Kernel& kernel, ocl::Queue& queue, ocl::Buffer& bufRes, const ocl::Buffer& bufLhs, const ocl::Buffer& bufRhs)
+	  {
+		  kernel( queue, bufRes.id(), bufLhs.id(), bufRhs.id() );
+		  queue.finish();
+	  };
+
+	  auto t = this->profile(std::bind(lambda, std::ref(*kernel_), std::ref(queue_), std::ref(bufRes), std::cref(bufLhs), std::cref(bufRhs)), dim, roofline_);
+
+	  if( testing_ )
+	  {
+		  std::vector<Type> res( M * NV );
+		  bufRes.read( queue_, 0u, res.data(), numResBytes);
+
+		  // The right-hand sides and the results are the columns of column-major matrices.
+		  verify( lhs.data(), rowMajor, rhs.data(), false, res.data(), false, M, NV, N ).report( std::cout );
+	  }
+
+
+	  program_.release();
+
+
+	  return t;
+}
+
+
+/*! Operation count function of the Pass.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_,class Format_ , size_t W, size_t VW, size_t NV>
+double GemvPass<Type_,Format_,W,VW,NV>::ops( utl::Dim const& dim )
+{
+	  size_t const M = dim[0];
+	  size_t const N = dim[1];
+
+	  return NV * M * (N + N - 1u);
+}
+
+
+/*! Traffic function of the Pass.
+ *
+ * Only the compulsory bytes are global traffic: the matrix and the right-hand sides are read
+ * once and the results written once. The re-reads of the right-hand sides, once per row in
+ * matvec2_rmajor and once per VW rows in matvec2_cmajor, are served by the caches and not
+ * counted, so that the achieved bandwidth stays comparable to the stream-copy peak.
+ * In matvec2_rmajor every thread stores one partial sum per right-hand side into local
+ * memory, and the W - 1 additions of the tree reduction read two and write one of them.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_,class Format_ , size_t W, size_t VW, size_t NV>
+Traffic GemvPass<Type_,Format_,W,VW,NV>::traffic( utl::Dim const& dim ) const
+{
+	  size_t const M = dim[0];
+	  size_t const N = dim[1];
+
+	  constexpr bool rowMajor = std::is_same<Format, utl::row_major_tag>::value;
+	  const double s = sizeof (Type);
+
+	  const double reads  = s * ( double( M ) * N + double( NV ) * N );
+	  const double writes = s * double( NV ) * M;
+
+	  if ( rowMajor ) return Traffic( reads, writes, s * M * NV * ( W + 3.0 * (W - 1) ) );
+
+	  return Traffic( reads, writes );
+}
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef GENERATEDPASS_H
+#define GENERATEDPASS_H
+
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <vector>
+#include <random>
+
+#include <ocl_wrapper.h>
+#include <utl_utils.h>
+
+#include "roofline.h"
+#include "verify.h"
+#include "kernelgen.h"
+#include "device.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+/*! GeneratedPass profiles a kernel which is generated at run time from a KernelSpec and is managed by the PassManager.
+ *
+ * The source is produced by generate() in the constructor, so new tile sizes, layouts or
+ * outputs only need a new KernelSpec, e.g. from the --kernel option of the profiler.
+ * The constructor throws if the spec needs more threads per work-group than the device
+ * allows. The operands are stored as described by the spec.
+ *
+ * \param Type_ is the value type of the matrices. Here we use float or double.
+*/
+template <class Type_>
+class GeneratedPass : public RooflinePass
+{
+	using Base   = RooflinePass;
+	using Type   = Type_;
+	using Dim    = utl::Dim;
+public :
+
+	GeneratedPass() = delete;
+	GeneratedPass(const GeneratedPass&) = default;
+	GeneratedPass(GeneratedPass&&) = default;
+	~GeneratedPass() = default;
+
+
+	/*! This is the constructor one should use to initialize the platform. */
+	GeneratedPass(const KernelSpec& spec,       /*! Description of the kernel */
+				  const Dim& start,              /*! First dimension e.g. Dim(128,128,128) with Dim[0]=M, Dim[1]=N, Dim[2]=K, */
+				  const Dim& step,               /*! Step dimension e.g. Dim(32,32,32) such that this pass iterates from first to last dimension */
+				  const Dim& end,                /*! Last dimension e.g. Dim(256,256,256) with Dim[0]=M, Dim[1]=N, Dim[2]=K, */
+				  bool testing = false,          /*! If true, verifies the gpu result, see verify.h */
+				  size_t iter = 10,              /*! Number of kernel iterations */
+				  DeviceType type = ocl::device_type::GPU); /*! Device type, e.g. ocl::device_type::CPU for PoCL */
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	utl::Seconds prof( Dim const& ) override;
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	double ops( Dim const& ) override;
+
+	/*! Bytes moved by the kernel including the zero padding of partial tiles. */
+	Traffic traffic( Dim const& ) const override;
+
+private :
+
+	std::string name(const KernelSpec& spec) const
+	{
+		std::ostringstream oss;
+		oss << "gen_" << spec.id() << "_" << utl::Type::type<Type>().name();
+		return oss.str();
+	}
+
+
+	bool testing_;
+	KernelSpec spec_;
+	ocl::Platform platform_; /*! Platform of the device type given to the constructor. Initialized in the constructor */
+	ocl::Device   device_;   /*! The first Device is chosen. Initialized in the constructor */
+	ocl::Context  context_;  /*! Only one Context is created. Initialized in the constructor */
+	ocl::Queue    queue_;    /*! Only one Queue is created with the above Context and Device. Initialized in the constructor */
+	ocl::Program  program_;  /*! Program is created from the generated source in the constructor but built in the prof() function with dimension parameters.*/
+	ocl::Kernel*  kernel_;   /*! Kernel is created in the constructor but built in the prof() function. */
+	Roofline<Type> roofline_; /*! Peaks of the device. Measured in the constructor */
+};
+
+
+template <class Type_>
+GeneratedPass<Type_>::GeneratedPass(
+		const KernelSpec& spec,
+		const utl::Dim& start,
+		const utl::Dim& step,
+		const utl::Dim& end,
+		bool testing,
+		size_t iter,
+		DeviceType type) :
+	  Base(this->name(spec), start, step, end, testing ? 1 : iter),
+	  testing_(testing),
+	  spec_(spec),
+	  platform_( type ),
+	  device_( platform_.device( type ) ),
+	  context_( device_ ),
+	  queue_( context_, device_, CL_QUEUE_PROFILING_ENABLE ),
+	  program_( context_, utl::type::Single | utl::type::Double ),
+	  kernel_(nullptr),
+	  roofline_( context_, queue_, type )
+{
+	const size_t maxThreads = maxWorkGroupSize( device_ );
+	if ( maxThreads ) spec_.check( maxThreads );
+
+	program_ << generate( spec_ );
+
+	kernel_ = &program_.kernel(spec_.name, utl::Type::type<Type_>());
+	if ( kernel_ == nullptr ) { throw std::runtime_error( "kernel not valid" ); }
+}
+
+
+/*! Profile function of the Pass.
+ *
+ * In testing mode dst starts as zeros, so every output computes op(A) * op(B), with
+ * alpha = beta = 1 for AlphaBeta.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_>
+utl::Seconds GeneratedPass<Type_>::prof( utl::Dim const& dim )
+{
+	  const size_t M = dim[0];
+	  const size_t N = dim[1];
+	  const size_t K = dim[2];
+
+	  if( N <= 0 ) throw std::runtime_error( "N should be greater 0." );
+	  if( M <= 0 ) throw std::runtime_error( "M should be greater 0." );
+	  spec_.check( M, N, K );
+
+	  program_.setCompileOption( ocl::compile_option::FAST_MATH | ocl::compile_option::NO_SIGNED_ZERO | ocl::CompileOption( spec_.options( M, N, K ) ) );
+	  program_.build();
+	  if ( ! program_.isBuilt() ) { throw std::runtime_error( "program not built" ); }
+	  if ( ! kernel_->created() ) { throw std::runtime_error( "kernel not created" ); }
+
+	  kernel_->setWorkSize( spec_.local0(), spec_.local1(), spec_.global0( N ), spec_.global1( M ) );
+
+	  const size_t numResBytes = sizeof (Type) * M * N;
+	  const size_t numLhsBytes = sizeof (Type) * M * K;
+	  const size_t numRhsBytes = sizeof (Type) * K * N;
+
+	  ocl::Buffer bufRes( context_, numResBytes, ocl::Buffer::ReadWrite );
+	  ocl::Buffer bufLhs( context_, numLhsBytes, ocl::Buffer::ReadOnly );
+	  ocl::Buffer bufRhs( context_, numRhsBytes, ocl::Buffer::ReadOnly );
+
+	  std::cout << "Running kernel with M=" << M << ", N=" << N << ", K=" << K << ", size[MB]=" << float(numLhsBytes)/float(1<<20) << std::endl;
+
+	  std::vector<Type> lhs, rhs;
+	  if(testing_){
+		  std::mt19937 gen( 4711 );
+		  std::uniform_real_distribution<double> dist( 0.0, 1.0 );
+		  lhs.resize( M * K );
+		  rhs.resize( K * N );
+		  for ( auto& x : lhs ) x = Type( dist( gen ) );
+		  for ( auto& x : rhs ) x = Type( dist( gen ) );
+		  const std::vector<Type> zeros( M * N, Type(0) );
+		  bufLhs.write( queue_, 0u, lhs.data(), numLhsBytes );
+		  bufRhs.write( queue_, 0u, rhs.data(), numRhsBytes );
+		  bufRes.write( queue_, 0u, zeros.data(), numResBytes );
+	  }
+
+
+	  // Function which repeated iter_ times from the Passmanager.
+	  const bool alphaBeta = spec_.output == KernelSpec::AlphaBeta;
+	  auto lambda = [alphaBeta](ocl::Kernel& kernel, ocl::Queue& queue, ocl::Buffer& bufRes, const ocl::Buffer& bufLhs, const ocl::Buffer& bufRhs)
+	  {
+		  if ( alphaBeta ) kernel( queue, bufRes.id(), bufLhs.id(), bufRhs.id(), Type(1), Type(1) );
+		  else             kernel( queue, bufRes.id(), bufLhs.id(), bufRhs.id() );
+		  queue.finish();
+	  };
+
+	  auto t = this->profile(std::bind(lambda, std::ref(*kernel_), std::ref(queue_), std::ref(bufRes), std::cref(bufLhs), std::cref(bufRhs)), dim, roofline_);
+
+	  if( testing_ )
+	  {
+		  std::vector<Type> res( M * N );
+		  bufRes.read( queue_, 0u, res.data(), numResBytes);
+
+		  verify( lhs.data(), spec_.rowMajorA != spec_.transA,
+				  rhs.data(), spec_.rowMajorB != spec_.transB,
+				  res.data(), spec_.rowMajorC, M, N, K ).report( std::cout );
+	  }
+
+
+	  program_.release();
+
+
+	  return t;
+}
+
+
+/*! Operation count function of the Pass.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_>
+double GeneratedPass<Type_>::ops( utl::Dim const& dim )
+{
+	  size_t const M = dim[0];
+	  size_t const N = dim[1];
+	  size_t const K = dim[2];
+
+	  const double extra = spec_.output == KernelSpec::Store ? 0.0 : spec_.output == KernelSpec::Accumulate ? 1.0 : 3.0;
+	  return double(M) * N * (K + K - 1u) + extra * M * N;
+}
+
+
+/*! Traffic function of the Pass.
+ *
+ * Every work-group reads a TM x K panel of src1 and a K x TN panel of src2. Per tile all
+ * TM * TK + TK * TN elements are stored to local memory, and every thread reads 1 + VW
+ * elements per step of the inner loop.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_>
+Traffic GeneratedPass<Type_>::traffic( utl::Dim const& dim ) const
+{
+	  size_t const M = dim[0];
+	  size_t const N = dim[1];
+	  size_t const K = dim[2];
+
+	  const double s      = sizeof (Type);
+	  const double rows   = double( (M + spec_.TM - 1) / spec_.TM );
+	  const double cols   = double( (N + spec_.TN - 1) / spec_.TN );
+	  const double tiles  = double( (K + spec_.TK - 1) / spec_.TK );
+	  const double groups = rows * cols;
+
+	  Traffic t( s * ( double( M ) * K * cols + double( K ) * N * rows ), s * M * N );
+	  if ( spec_.output != KernelSpec::Store ) t.reads += s * M * N;
+	  t.local = s * groups * tiles * ( spec_.TM * spec_.TK + spec_.TK * spec_.TN + spec_.threads() * spec_.TK * (1.0 + spec_.VW) );
+	  return t;
+}
+
+#endif
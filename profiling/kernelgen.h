@@ -0,0 +1,257 @@
+#ifndef KERNELGEN_H
+#define KERNELGEN_H
+
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <cstddef>
+
+
+/*! Description of a generated multiplication kernel dst = op(src1) * op(src2).
+ *
+ * op(src1) is M x K and op(src2) is K x N, where op transposes the stored operand if
+ * the corresponding trans flag is set. Each operand is stored in row- or column-major
+ * format. A work-group computes a TM x TN tile of dst and walks K in steps of TK through
+ * local memory. Each of its TM * TN / VW threads accumulates VW consecutive columns of
+ * one row in registers.
+ *
+ * The generated source keeps the conventions of the hand-written kernels: it is
+ * templated on TYPE and expects M, N and K as compile definitions, see options().
+*/
+struct KernelSpec
+{
+	enum Edge   { Exact, Guard };                 /*! Exact requires multiples of the tile sizes, Guard pads with zeros. */
+	enum Output { Store, Accumulate, AlphaBeta };  /*! dst = acc, dst += acc or dst = alpha * acc + beta * dst. */
+
+	std::string name  = "gemm";   /*! Name of the kernel function */
+	std::string accum = "TYPE";   /*! Type of the accumulators, e.g. double for float operands */
+
+	bool rowMajorA = true;
+	bool rowMajorB = true;
+	bool rowMajorC = true;
+	bool transA    = false;
+	bool transB    = false;
+
+	size_t TM = 16;               /*! Rows of dst per work-group */
+	size_t TN = 16;               /*! Columns of dst per work-group */
+	size_t TK = 16;               /*! Depth of the local tiles */
+	size_t VW = 1;                /*! Columns of dst per thread */
+
+	Edge   edge   = Guard;
+	Output output = Store;
+
+	/*! Threads per work-group. */
+	size_t threads() const { return TM * TN / VW; }
+
+	/*! Work sizes for setWorkSize( local0(), local1(), global0(N), global1(M) ). */
+	size_t local0() const { return TN / VW; }
+	size_t local1() const { return TM; }
+	size_t global0( size_t N ) const { return (N + TN - 1) / TN * local0(); }
+	size_t global1( size_t M ) const { return (M + TM - 1) / TM * TM; }
+
+	/*! Compile definitions for an M x N x K product. */
+	std::string options( size_t M, size_t N, size_t K ) const
+	{
+		std::ostringstream oss;
+		oss << "-w -Werror" << " -D M=" << M << "u -D N=" << N << "u -D K=" << K << 'u';
+		return oss.str();
+	}
+
+	/*! Unique name of the variant, e.g. for pass names. */
+	std::string id() const
+	{
+		std::ostringstream oss;
+		oss << name << "_" << ( rowMajorA ? 'r' : 'c' ) << ( transA ? "t" : "" )
+		            << "_" << ( rowMajorB ? 'r' : 'c' ) << ( transB ? "t" : "" )
+		            << "_" << ( rowMajorC ? 'r' : 'c' )
+		    << "_" << TM << "x" << TN << "x" << TK << "_V" << VW
+		    << ( edge == Guard ? "_guard" : "_exact" )
+		    << ( output == Store ? "" : output == Accumulate ? "_acc" : "_ab" )
+		    << ( accum == "TYPE" ? "" : "_" + accum );
+		return oss.str();
+	}
+
+	/*! Throws if the parameters are inconsistent. */
+	void check() const
+	{
+		if ( TM == 0 || TN == 0 || TK == 0 || VW == 0 ) throw std::runtime_error( "tile sizes should be greater 0." );
+		if ( TN % VW ) throw std::runtime_error( "TN should be a multiple of VW." );
+		if ( name.empty() ) throw std::runtime_error( "kernel name is empty." );
+	}
+
+	/*! Throws if an M x N x K product cannot be computed with this variant. */
+	void check( size_t M, size_t N, size_t K ) const
+	{
+		check();
+		if ( edge == Exact && ( M % TM || N % TN || K % TK ) ) throw std::runtime_error( "M, N and K should be multiples of TM, TN and TK." );
+	}
+
+	/*! Throws if a work-group needs more than maxThreads threads, e.g. CL_DEVICE_MAX_WORK_GROUP_SIZE of the device. */
+	void check( size_t maxThreads ) const
+	{
+		if ( threads() <= maxThreads ) return;
+		std::ostringstream oss;
+		oss << "kernel " << id() << " needs TM * TN / VW = " << threads() << " threads per work-group, the device allows " << maxThreads << ".";
+		throw std::runtime_error( oss.str() );
+	}
+
+	/*! Sets a parameter from its textual form, e.g. set("TM", "32") or set("layoutA", "col"). */
+	void set( const std::string& key, const std::string& value );
+
+	/*! Parses key=value pairs separated by blanks or commas, e.g. "TM=32,TN=32,VW=4". Unset keys keep their defaults. */
+	static KernelSpec parse( const std::string& text );
+};
+
+
+inline void KernelSpec::set( const std::string& key, const std::string& value )
+{
+	auto const layout = [&]() -> bool
+	{
+		if ( value == "row" ) return true;
+		if ( value == "col" ) return false;
+		throw std::runtime_error( "layout should be row or col: " + value );
+	};
+	auto const flag = [&]() -> bool
+	{
+		if ( value == "1" || value == "true" ) return true;
+		if ( value == "0" || value == "false" ) return false;
+		throw std::runtime_error( "flag should be 0 or 1: " + value );
+	};
+	auto const size = [&]() -> size_t
+	{
+		size_t pos = 0;
+		unsigned long n = 0;
+		try { n = std::stoul( value, &pos ); } catch ( const std::logic_error& ) { pos = 0; }
+		if ( pos == 0 || pos != value.size() ) throw std::runtime_error( "size expected: " + value );
+		return size_t( n );
+	};
+
+	if      ( key == "name" )    name = value;
+	else if ( key == "accum" )   accum = value;
+	else if ( key == "layoutA" ) rowMajorA = layout();
+	else if ( key == "layoutB" ) rowMajorB = layout();
+	else if ( key == "layoutC" ) rowMajorC = layout();
+	else if ( key == "transA" )  transA = flag();
+	else if ( key == "transB" )  transB = flag();
+	else if ( key == "TM" )      TM = size();
+	else if ( key == "TN" )      TN = size();
+	else if ( key == "TK" )      TK = size();
+	else if ( key == "VW" )      VW = size();
+	else if ( key == "edge" )
+	{
+		if      ( value == "exact" ) edge = Exact;
+		else if ( value == "guard" ) edge = Guard;
+		else throw std::runtime_error( "edge should be exact or guard: " + value );
+	}
+	else if ( key == "output" )
+	{
+		if      ( value == "store" )      output = Store;
+		else if ( value == "accumulate" ) output = Accumulate;
+		else if ( value == "alphabeta" )  output = AlphaBeta;
+		else throw std::runtime_error( "output should be store, accumulate or alphabeta: " + value );
+	}
+	else throw std::runtime_error( "unknown kernel parameter: " + key );
+}
+
+
+inline KernelSpec KernelSpec::parse( const std::string& text )
+{
+	KernelSpec spec;
+	std::string pairs = text;
+	for ( auto& ch : pairs ) if ( ch == ',' ) ch = ' ';
+
+	std::istringstream iss( pairs );
+	std::string pair;
+	while ( iss >> pair )
+	{
+		const size_t eq = pair.find( '=' );
+		if ( eq == std::string::npos ) throw std::runtime_error( "key=value expected: " + pair );
+		spec.set( pair.substr( 0, eq ), pair.substr( eq + 1 ) );
+	}
+	return spec;
+}
+
+
+/*! Emits the OpenCL C source of the kernel described by spec.
+ *
+ * The arguments are (dst, src1, src2) and, for AlphaBeta, (alpha, beta). Local tiles are
+ * filled cooperatively by all threads; the fill order follows the storage of each
+ * operand so that neighbouring threads load neighbouring addresses.
+*/
+inline std::string generate( const KernelSpec& spec )
+{
+	spec.check();
+
+	const bool guard = spec.edge == KernelSpec::Guard;
+
+	// Index of op(src1)(r,k), op(src2)(k,c) and dst(r,c) in their buffers.
+	const bool aRows = spec.rowMajorA != spec.transA;
+	const bool bRows = spec.rowMajorB != spec.transB;
+	const std::string a = aRows ? "(r) * K + (k)" : "(k) * M + (r)";
+	const std::string b = bRows ? "(k) * N + (c)" : "(c) * K + (k)";
+	const std::string c = spec.rowMajorC ? "row * N + col" : "col * M + row";
+
+	std::ostringstream os;
+	os << "\n// Generated by kernelgen.h: " << spec.id() << "\n"
+	   << "#define A_INDEX(r, k) (" << a << ")\n"
+	   << "#define B_INDEX(k, c) (" << b << ")\n\n"
+	   << "template<class TYPE>\n"
+	   << "__kernel void " << spec.name << "(__global TYPE *dst, __global TYPE *src1, __global TYPE *src2"
+	   << ( spec.output == KernelSpec::AlphaBeta ? ", TYPE alpha, TYPE beta" : "" ) << ")\n"
+	   << "{\n"
+	   << "    __local TYPE As[" << spec.TM << "][" << spec.TK << "];\n"
+	   << "    __local TYPE Bs[" << spec.TK << "][" << spec.TN << "];\n\n"
+	   << "    const unsigned int l_col = get_local_id(0);\n"
+	   << "    const unsigned int l_row = get_local_id(1);\n"
+	   << "    const unsigned int lid   = l_row * " << spec.local0() << " + l_col;\n"
+	   << "    const unsigned int row0  = get_group_id(1) * " << spec.TM << ";\n"
+	   << "    const unsigned int col0  = get_group_id(0) * " << spec.TN << ";\n\n"
+	   << "    " << spec.accum << " acc[" << spec.VW << "];\n"
+	   << "    for (unsigned int v = 0; v < " << spec.VW << "; ++v)\n"
+	   << "        acc[v] = 0;\n\n"
+	   << "    for (unsigned int k0 = 0; k0 < K; k0 += " << spec.TK << ") {\n";
+
+	// Row-major tiles are filled along k, column-major tiles along r, and likewise for B.
+	os << "        for (unsigned int i = lid; i < " << spec.TM * spec.TK << "; i += " << spec.threads() << ") {\n";
+	if ( aRows ) os << "            const unsigned int r = i / " << spec.TK << ", k = i % " << spec.TK << ";\n";
+	else         os << "            const unsigned int r = i % " << spec.TM << ", k = i / " << spec.TM << ";\n";
+	if ( guard ) os << "            As[r][k] = (row0 + r < M && k0 + k < K) ? src1[A_INDEX(row0 + r, k0 + k)] : 0;\n";
+	else         os << "            As[r][k] = src1[A_INDEX(row0 + r, k0 + k)];\n";
+	os << "        }\n";
+
+	os << "        for (unsigned int i = lid; i < " << spec.TK * spec.TN << "; i += " << spec.threads() << ") {\n";
+	if ( bRows ) os << "            const unsigned int k = i / " << spec.TN << ", c = i % " << spec.TN << ";\n";
+	else         os << "            const unsigned int k = i % " << spec.TK << ", c = i / " << spec.TK << ";\n";
+	if ( guard ) os << "            Bs[k][c] = (k0 + k < K && col0 + c < N) ? src2[B_INDEX(k0 + k, col0 + c)] : 0;\n";
+	else         os << "            Bs[k][c] = src2[B_INDEX(k0 + k, col0 + c)];\n";
+	os << "        }\n\n";
+
+	os << "        barrier(CLK_LOCAL_MEM_FENCE);\n\n"
+	   << "        for (unsigned int e = 0; e < " << spec.TK << "; ++e) {\n"
+	   << "            const " << spec.accum << " x = As[l_row][e];\n"
+	   << "            for (unsigned int v = 0; v < " << spec.VW << "; ++v)\n"
+	   << "                acc[v] += x * Bs[e][l_col * " << spec.VW << " + v];\n"
+	   << "        }\n"
+	   << "        barrier(CLK_LOCAL_MEM_FENCE);\n"
+	   << "    }\n\n"
+	   << "    const unsigned int row = row0 + l_row;\n"
+	   << "    for (unsigned int v = 0; v < " << spec.VW << "; ++v) {\n"
+	   << "        const unsigned int col = col0 + l_col * " << spec.VW << " + v;\n";
+	if ( guard ) os << "        if (row >= M || col >= N) continue;\n";
+
+	switch ( spec.output )
+	{
+	case KernelSpec::Store:      os << "        dst[" << c << "] = acc[v];\n"; break;
+	case KernelSpec::Accumulate: os << "        dst[" << c << "] += acc[v];\n"; break;
+	case KernelSpec::AlphaBeta:  os << "        dst[" << c << "] = alpha * acc[v] + (beta != 0 ? beta * dst[" << c << "] : 0);\n"; break;
+	}
+
+	os << "    }\n"
+	   << "}\n\n"
+	   << "#undef A_INDEX\n"
+	   << "#undef B_INDEX\n";
+
+	return os.str();
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "../kernelgen.h"
+
+
+/*! Writes the source of a generated kernel, see kernelgen.h.
+ *
+ * Usage: kernelgen [-o file] [-t threads] key=value ...
+ * e.g.   kernelgen name=multiplyr_gen TM=32 TN=32 TK=8 VW=4 layoutB=col edge=exact
+ *
+ * -t is the maximal work-group size of the target device, CL_DEVICE_MAX_WORK_GROUP_SIZE.
+ * It defaults to 256, which most devices support.
+*/
+int main( int argc, char** argv )
+{
+	KernelSpec spec;
+	std::string output;
+	size_t maxThreads = 256;
+
+	try
+	{
+		for ( int i = 1; i < argc; ++i )
+		{
+			const std::string arg = argv[i];
+			if ( arg == "-o" && i + 1 < argc ) { output = argv[++i]; continue; }
+			if ( arg == "-t" && i + 1 < argc )
+			{
+				const std::string value = argv[++i];
+				size_t pos = 0;
+				try { maxThreads = std::stoul( value, &pos ); } catch ( const std::logic_error& ) { pos = 0; }
+				if ( pos == 0 || pos != value.size() ) throw std::runtime_error( "threads expected: " + value );
+				continue;
+			}
+
+			const size_t eq = arg.find( '=' );
+			if ( eq == std::string::npos ) throw std::runtime_error( "key=value expected: " + arg );
+			spec.set( arg.substr( 0, eq ), arg.substr( eq + 1 ) );
+		}
+
+		spec.check( maxThreads );
+		const std::string source = generate( spec );
+
+		if ( output.empty() ) { std::cout << source; return EXIT_SUCCESS; }
+
+		std::ofstream file( output );
+		if ( !file.is_open() ) throw std::runtime_error( "Failed opening file " + output );
+		file << source;
+	}
+	catch ( const std::exception& e )
+	{
+		std::cerr << argv[0] << ": " << e.what() << std::endl;
+		std::cerr << "Usage: " << argv[0] << " [-o file] [-t threads] key=value ..." << std::endl
+		          << "Keys: name accum layoutA layoutB layoutC transA transB TM TN TK VW edge output" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,264 @@
+#ifndef MATFILE_H
+#define MATFILE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+
+#include <ocl_wrapper.h>
+#include <utl_utils.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+/*! Header of a binary matrix file.
+ *
+ * The file starts with this header in host byte order, followed by the payload at
+ * offset, which is a multiple of ALIGNMENT. The payload holds outer vectors of ld
+ * elements each: rows for row-major, columns for column-major files. Element (r,c) lies
+ * at r * ld + c or c * ld + r. Since mappings start at page boundaries, the payload of a
+ * mapped file is aligned for vector loads and DMA transfers.
+*/
+struct MatrixFileHeader
+{
+	static constexpr uint32_t VERSION   = 1;
+	static constexpr uint64_t ALIGNMENT = 64;
+
+	enum Type   : uint32_t { Float = 1, Double = 2, Int = 3 };
+	enum Layout : uint32_t { RowMajor = 0, ColumnMajor = 1 };
+
+	char     magic[8];    /*! "FMMATRIX" */
+	uint32_t version;     /*! VERSION */
+	uint32_t type;        /*! Value type, see Type */
+	uint32_t layout;      /*! Storage format, see Layout */
+	uint32_t elementSize; /*! sizeof of the value type */
+	uint64_t rows;
+	uint64_t cols;
+	uint64_t ld;          /*! Distance of two rows (row-major) or columns (column-major) in elements */
+	uint64_t offset;      /*! Byte offset of the payload */
+	uint64_t reserved;
+
+	/*! Number of rows (row-major) or columns (column-major). */
+	uint64_t outer() const { return layout == RowMajor ? rows : cols; }
+
+	/*! Number of elements within a row (row-major) or column (column-major). */
+	uint64_t inner() const { return layout == RowMajor ? cols : rows; }
+
+	/*! Bytes of the payload. Only valid if bytesOverflow() is false. */
+	uint64_t bytes() const { return outer() * ld * elementSize; }
+
+	/*! True if offset + bytes() does not fit into 64 bits, e.g. for a corrupt header. */
+	bool bytesOverflow() const
+	{
+		const uint64_t max = UINT64_MAX;
+		if ( ld && outer() > max / ld ) return true;
+		const uint64_t elements = outer() * ld;
+		if ( elementSize && elements > max / elementSize ) return true;
+		return offset > max - elements * elementSize;
+	}
+
+	template <class T>
+	static Type typeOf()
+	{
+		static_assert( std::is_same<T,float>::value || std::is_same<T,double>::value || std::is_same<T,int>::value, "unsupported value type" );
+		return std::is_same<T,float>::value ? Float : std::is_same<T,double>::value ? Double : Int;
+	}
+};
+
+static_assert( sizeof (MatrixFileHeader) == MatrixFileHeader::ALIGNMENT, "header should fill one alignment unit" );
+
+
+/*! Writes a rows x cols matrix with leading dimension ld, which defaults to the dense one.
+ *
+ * data holds all rows (row-major) or columns (column-major) including their padding up to ld.
+*/
+template <class T>
+void saveMatrix( const std::string& file, const T* data, size_t rows, size_t cols, bool rowMajor, size_t ld = 0 )
+{
+	MatrixFileHeader h;
+	std::memset( &h, 0, sizeof h );
+	std::memcpy( h.magic, "FMMATRIX", 8 );
+	h.version     = MatrixFileHeader::VERSION;
+	h.type        = MatrixFileHeader::typeOf<T>();
+	h.layout      = rowMajor ? MatrixFileHeader::RowMajor : MatrixFileHeader::ColumnMajor;
+	h.elementSize = sizeof (T);
+	h.rows        = rows;
+	h.cols        = cols;
+	h.ld          = ld ? ld : h.inner();
+	h.offset      = sizeof h;
+
+	if ( h.ld < h.inner() ) throw std::runtime_error( "leading dimension too small for " + file );
+
+	std::ofstream stream( file, std::ios::binary );
+	if ( !stream.is_open() ) { throw std::runtime_error("Failed opening file " + file);}
+	stream.write( reinterpret_cast<const char*>( &h ), sizeof h );
+	stream.write( reinterpret_cast<const char*>( data ), std::streamsize( h.bytes() ) );
+	if ( !stream ) throw std::runtime_error( "Failed writing file " + file );
+}
+
+
+/*! Writes a utl::Matrix. */
+template <class T, class Format>
+void saveMatrix( const std::string& file, const utl::Matrix<T, Format>& m )
+{
+	saveMatrix( file, m.data(), m.rows(), m.cols(), std::is_same<Format, utl::row_major_tag>::value );
+}
+
+
+/*! Read-only memory mapping of a matrix file.
+ *
+ * The payload is used in place: data() points into the mapping, so an upload with
+ * upload() moves the file contents to the device without a copy on the host. The
+ * pages are read on first access, so opening a large file is cheap.
+*/
+class MappedMatrix
+{
+public :
+	MappedMatrix(const MappedMatrix&) = delete;
+	MappedMatrix& operator=(const MappedMatrix&) = delete;
+
+	/*! Maps the file and validates its header. */
+	explicit MappedMatrix( const std::string& file );
+
+	~MappedMatrix()
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		if ( map_ ) munmap( map_, size_ );
+#endif
+	}
+
+	const MatrixFileHeader& header() const { return *static_cast<const MatrixFileHeader*>( map_ ); }
+
+	size_t rows()     const { return header().rows; }
+	size_t cols()     const { return header().cols; }
+	size_t ld()       const { return header().ld; }
+	bool   rowMajor() const { return header().layout == MatrixFileHeader::RowMajor; }
+
+	/*! True if there is no padding between the rows or columns. */
+	bool contiguous() const { return header().ld == header().inner(); }
+
+	/*! Payload as values of type T. Throws if the file holds another type. */
+	template <class T>
+	const T* data() const
+	{
+		if ( header().type != MatrixFileHeader::typeOf<T>() ) throw std::runtime_error( "value type of " + file_ + " does not match" );
+		return reinterpret_cast<const T*>( static_cast<const char*>( map_ ) + header().offset );
+	}
+
+	/*! Dense copy in the given storage format. */
+	template <class T>
+	std::vector<T> pack( bool rowMajor ) const;
+
+	const std::string& file() const { return file_; }
+
+private :
+	std::string file_;
+	void*       map_;
+	size_t      size_;
+};
+
+
+inline MappedMatrix::MappedMatrix( const std::string& file ) :
+	file_( file ),
+	map_( nullptr ),
+	size_( 0 )
+{
+#if defined(__unix__) || defined(__APPLE__)
+	const int fd = open( file.c_str(), O_RDONLY );
+	if ( fd < 0 ) { throw std::runtime_error("Failed opening file " + file);}
+
+	struct stat st;
+	if ( fstat( fd, &st ) != 0 || size_t( st.st_size ) < sizeof (MatrixFileHeader) ) { close( fd ); throw std::runtime_error( "No matrix file: " + file ); }
+
+	size_ = size_t( st.st_size );
+	void* map = mmap( nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( map == MAP_FAILED ) throw std::runtime_error( "Failed mapping file " + file );
+	map_ = map;
+
+	const MatrixFileHeader& h = header();
+	const char* error = nullptr;
+	if      ( std::memcmp( h.magic, "FMMATRIX", 8 ) != 0 )                   error = "No matrix file: ";
+	else if ( h.version != MatrixFileHeader::VERSION )                       error = "Unsupported version of matrix file: ";
+	else if ( h.layout > MatrixFileHeader::ColumnMajor )                     error = "Unknown layout of matrix file: ";
+	else if ( h.type < MatrixFileHeader::Float || h.type > MatrixFileHeader::Int ||
+			  h.elementSize != ( h.type == MatrixFileHeader::Double ? 8u : 4u ) ) error = "Unknown value type of matrix file: ";
+	else if ( h.offset % MatrixFileHeader::ALIGNMENT || h.offset < sizeof h ) error = "Misaligned payload of matrix file: ";
+	else if ( h.ld < h.inner() )                                             error = "Leading dimension too small in matrix file: ";
+	else if ( h.bytesOverflow() )                                            error = "Corrupt sizes in matrix file: ";
+	else if ( h.offset + h.bytes() > size_ )                                 error = "Truncated matrix file: ";
+
+	if ( error )
+	{
+		munmap( map_, size_ );
+		map_ = nullptr;
+		throw std::runtime_error( error + file );
+	}
+#else
+	throw std::runtime_error( "Memory mapped matrix files are not supported on this system: " + file );
+#endif
+}
+
+
+template <class T>
+std::vector<T> MappedMatrix::pack( bool rowMajor ) const
+{
+	const T* src = data<T>();
+	const size_t R = rows(), C = cols(), L = ld();
+
+	std::vector<T> dst( R * C );
+	for ( size_t r = 0; r < R; ++r )
+		for ( size_t c = 0; c < C; ++c )
+			dst[rowMajor ? r * C + c : c * R + r] = src[this->rowMajor() ? r * L + c : c * L + r];
+	return dst;
+}
+
+
+/*! Copies a mapped matrix into a utl::Matrix, which owns its storage. */
+template <class T, class Format>
+utl::Matrix<T, Format> toMatrix( const MappedMatrix& m )
+{
+	constexpr bool rowMajor = std::is_same<Format, utl::row_major_tag>::value;
+
+	utl::Matrix<T, Format> dense = utl::Zeros<T, Format>( m.rows(), m.cols() );
+	const std::vector<T> packed = m.pack<T>( rowMajor );
+	std::copy( packed.begin(), packed.end(), dense.data() );
+	return dense;
+}
+
+
+/*! Writes a mapped matrix densely in the given storage format to the start of buffer.
+ *
+ * Contiguous files in the requested format are written straight from the mapping,
+ * all others are packed on the host first.
+*/
+template <class T>
+void upload( const MappedMatrix& m, ocl::Buffer& buffer, ocl::Queue& queue, bool rowMajor )
+{
+	const size_t bytes = sizeof (T) * m.rows() * m.cols();
+
+	if ( m.contiguous() && m.rowMajor() == rowMajor )
+	{
+		buffer.write( queue, 0u, m.data<T>(), bytes );
+		return;
+	}
+
+	const std::vector<T> packed = m.pack<T>( rowMajor );
+	buffer.write( queue, 0u, packed.data(), bytes );
+}
+
+#endif
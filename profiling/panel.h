@@ -0,0 +1,272 @@
+#ifndef PANELPASS_H
+#define PANELPASS_H
+
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <istream>
+#include <vector>
+#include <cmath>
+
+#include <ocl_wrapper.h>
+#include <utl_utils.h>
+
+#include "roofline.h"
+#include "verify.h"
+#include "view.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+/*! PanelPass profiles multiplyr_view as a sequence of in-place panel updates and is managed by the PassManager.
+ *
+ * All three operands are views into parent buffers which are larger by Margin rows and
+ * columns on every side. The product is accumulated over K / P panels: the first launch
+ * writes dst = A(:,0:P) * B(0:P,:), every further launch adds A(:,k:k+P) * B(k:k+P,:).
+ * No panel is copied and no buffer is allocated between the launches.
+ *
+ * \param Type_ is the value type of the matrices. Here we use float or double.
+ * \param W is the tile size of the kernel.
+ * \param P is the panel width. K must be a multiple of P and P a multiple of W.
+ * \param Margin is the number of parent rows and columns around every view.
+*/
+template <class Type_, size_t W, size_t P, size_t Margin>
+class PanelPass : public RooflinePass
+{
+	using Base   = RooflinePass;
+	using Type   = Type_;
+	using Format = utl::row_major_tag;
+	using Rand   = utl::Rand  < Type, Format, utl::uniform_dist_tag >;
+	using Zeros  = utl::Zeros < Type, Format >;
+	using Matrix = utl::Matrix< Type, Format >;
+	using Dim    = utl::Dim;
+public :
+
+	PanelPass() = delete;
+	PanelPass(const PanelPass&) = default;
+	PanelPass(PanelPass&&) = default;
+	~PanelPass() = default;
+
+
+	/*! This is the constructor one should use to initialize the platform. */
+	PanelPass(const std::string& filename,   /*! Name of the *.cl file with multiplyr_view, i.e. view.cl */
+			  const Dim& start,              /*! First dimension e.g. Dim(128,128,128) with Dim[0]=M, Dim[1]=N, Dim[2]=K, */
+			  const Dim& step,               /*! Step dimension e.g. Dim(32,32,32) such that this pass iterates from first to last dimension */
+			  const Dim& end,                /*! Last dimension e.g. Dim(256,256,256) with Dim[0]=M, Dim[1]=N, Dim[2]=K, */
+			  bool testing = false,          /*! If true, verifies the gpu result, see verify.h */
+			  size_t iter = 10,              /*! Number of kernel iterations */
+			  DeviceType type = ocl::device_type::GPU); /*! Device type, e.g. ocl::device_type::CPU for PoCL */
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	utl::Seconds prof( Dim const& ) override;
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	double ops( Dim const& ) override;
+
+	/*! Bytes moved by all panel updates. */
+	Traffic traffic( Dim const& ) const override;
+
+private :
+
+	std::string name() const
+	{
+		std::ostringstream oss;
+		oss << "panel_multiplyr_view_" << utl::Type::type<Type>().name() <<  "_B" << W << "_P" << P << "_G" << Margin;
+		return oss.str();
+	}
+
+	/*! Copies the elements of view v of the parent into a dense matrix. */
+	static Matrix extract( const Matrix& parent, const View& v );
+
+
+	bool testing_;
+	ocl::Platform platform_; /*! Platform of the device type given to the constructor. Initialized in the constructor */
+	ocl::Device   device_;   /*! The first Device is chosen. Initialized in the constructor */
+	ocl::Context  context_;  /*! Only one Context is created. Initialized in the constructor */
+	ocl::Queue    queue_;    /*! Only one Queue is created with the above Context and Device. Initialized in the constructor */
+	ocl::Program  program_;  /*! Program is created in the constructor but built in the prof() function with dimension parameters.*/
+	ocl::Kernel*  kernel_;   /*! Kernel is created in the constructor but built in the prof() function. */
+	Roofline<Type> roofline_; /*! Peaks of the device. Measured in the constructor */
+};
+
+
+template <class Type_, size_t W, size_t P, size_t Margin>
+PanelPass<Type_,W,P,Margin>::PanelPass(
+		const std::string& file,
+		const utl::Dim& start,
+		const utl::Dim& step,
+		const utl::Dim& end,
+		bool testing,
+		size_t iter,
+		DeviceType type) :
+	  Base(this->name(), start, step, end, testing ? 1 : iter),
+	  testing_(testing),
+	  platform_( type ),
+	  device_( platform_.device( type ) ),
+	  context_( device_ ),
+	  queue_( context_, device_, CL_QUEUE_PROFILING_ENABLE ),
+	  program_( context_, utl::type::Single | utl::type::Double ),
+	  kernel_(nullptr),
+	  roofline_( context_, queue_, type )
+{
+	std::ifstream stream( file );
+	if ( !stream.is_open() ) { throw std::runtime_error("Failed opening file " + file);}
+	program_ << stream;
+
+	kernel_ = &program_.kernel("multiplyr_view", utl::Type::type<Type_>());
+	if ( kernel_ == nullptr ) { throw std::runtime_error( "kernel not valid" ); }
+}
+
+
+template <class Type_, size_t W, size_t P, size_t Margin>
+typename PanelPass<Type_,W,P,Margin>::Matrix PanelPass<Type_,W,P,Margin>::extract( const Matrix& parent, const View& v )
+{
+	Matrix dense = Zeros( v.rows, v.cols );
+	for ( size_t r = 0; r < v.rows; ++r )
+		for ( size_t c = 0; c < v.cols; ++c )
+			dense.data()[r * v.cols + c] = parent.data()[v.index( r, c )];
+	return dense;
+}
+
+
+/*! Profile function of the Pass.
+ *
+ * The kernel is compiled for one panel, i.e. with K = P.
+ * In testing mode the margin of the result parent is checked to be untouched as well.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W, size_t P, size_t Margin>
+utl::Seconds PanelPass<Type_,W,P,Margin>::prof( utl::Dim const& dim )
+{
+	  const size_t M = dim[0];
+	  const size_t N = dim[1];
+	  const size_t K = dim[2];
+
+	  static_assert(P % W == 0, "P is not a multiple of W");
+
+	  if( N <= 0 ) throw std::runtime_error( "N should be greater 0." );
+	  if( M <= 0 ) throw std::runtime_error( "M should be greater 0." );
+	  if( M % W || N % W ) throw std::runtime_error( "M and N should be multiples of W." );
+	  if( K % P ) throw std::runtime_error( "K should be a multiple of P." );
+
+	  std::ostringstream oss;
+	  oss << "-w -Werror" << " -D M=" << M << "u -D N=" << N << "u -D W=" << W << "u -D K=" << P << 'u';
+
+	  program_.setCompileOption( ocl::compile_option::FAST_MATH | ocl::compile_option::NO_SIGNED_ZERO | ocl::CompileOption( oss.str() ) );
+	  program_.build();
+	  if ( ! program_.isBuilt() ) { throw std::runtime_error( "program not built" ); }
+	  if ( ! kernel_->created() ) { throw std::runtime_error( "kernel not created" ); }
+
+	  // Axis 0 walks the columns of dst, axis 1 its rows.
+	  kernel_->setWorkSize( W, W, N, M );
+
+	  const View res = View( M + 2 * Margin, N + 2 * Margin ).sub( Margin, Margin, M, N );
+	  const View lhs = View( M + 2 * Margin, K + 2 * Margin ).sub( Margin, Margin, M, K );
+	  const View rhs = View( K + 2 * Margin, N + 2 * Margin ).sub( Margin, Margin, K, N );
+
+	  const size_t numResBytes = sizeof (Type) * (M + 2 * Margin) * (N + 2 * Margin);
+	  const size_t numLhsBytes = sizeof (Type) * (M + 2 * Margin) * (K + 2 * Margin);
+	  const size_t numRhsBytes = sizeof (Type) * (K + 2 * Margin) * (N + 2 * Margin);
+
+	  ocl::Buffer bufRes( context_, numResBytes, ocl::Buffer::ReadWrite );
+	  ocl::Buffer bufLhs( context_, numLhsBytes, ocl::Buffer::ReadOnly );
+	  ocl::Buffer bufRhs( context_, numRhsBytes, ocl::Buffer::ReadOnly );
+
+	  std::cout << "Running kernel with M=" << M << ", N=" << N << ", K=" << K << ", panels=" << K / P << ", size[MB]=" << float(numLhsBytes)/float(1<<20) << std::endl;
+
+	  Matrix lhsParent;
+	  Matrix rhsParent;
+	  Matrix resParent;
+	  if(testing_){
+		  lhsParent = Rand (M + 2 * Margin, K + 2 * Margin);
+		  rhsParent = Rand (K + 2 * Margin, N + 2 * Margin);
+		  resParent = Rand (M + 2 * Margin, N + 2 * Margin);
+		  bufLhs.write( queue_, 0u, lhsParent.data(), numLhsBytes );
+		  bufRhs.write( queue_, 0u, rhsParent.data(), numRhsBytes );
+		  bufRes.write( queue_, 0u, resParent.data(), numResBytes );
+	  }
+
+
+	  // Function which repeated iter_ times from the Passmanager.
+	  auto lambda = [res, lhs, rhs, K](ocl::Kernel& kernel, ocl::Queue& queue, ocl::Buffer& bufRes, const ocl::Buffer& bufLhs, const ocl::Buffer& bufRhs)
+	  {
+		  for ( size_t k = 0; k < K; k += P )
+		  {
+			  const View a = lhs.sub( 0, k, lhs.rows, P );
+			  const View b = rhs.sub( k, 0, P, rhs.cols );
+			  kernel( queue,
+					  bufRes.id(), unsigned(res.offset), unsigned(res.ld),
+					  bufLhs.id(), unsigned(a.offset),   unsigned(a.ld),
+					  bufRhs.id(), unsigned(b.offset),   unsigned(b.ld),
+					  k == 0 ? Type(0) : Type(1) );
+		  }
+		  queue.finish();
+	  };
+
+	  auto t = this->profile(std::bind(lambda, std::ref(*kernel_), std::ref(queue_), std::ref(bufRes), std::cref(bufLhs), std::cref(bufRhs)), dim, roofline_);
+
+	  if( testing_ )
+	  {
+		  Matrix out = Zeros( M + 2 * Margin, N + 2 * Margin );
+		  bufRes.read( queue_, 0u, out.data(), numResBytes);
+
+		  size_t touched = 0;
+		  for ( size_t r = 0; r < M + 2 * Margin; ++r )
+			  for ( size_t c = 0; c < N + 2 * Margin; ++c )
+			  {
+				  const bool inside = r >= Margin && r < Margin + M && c >= Margin && c < Margin + N;
+				  if ( !inside && out.data()[r * res.ld + c] != resParent.data()[r * res.ld + c] ) ++touched;
+			  }
+
+		  verify( extract( lhsParent, lhs ), extract( rhsParent, rhs ), extract( out, res ) ).report( std::cout );
+		  std::cout << "Margin elements written: " << touched << std::endl;
+		  if ( touched ) ++failedChecks();
+	  }
+
+
+	  program_.release();
+
+
+	  return t;
+}
+
+
+/*! Operation count function of the Pass.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W, size_t P, size_t Margin>
+double PanelPass<Type_,W,P,Margin>::ops( utl::Dim const& dim )
+{
+	  size_t const M = dim[0];
+	  size_t const N = dim[1];
+	  size_t const K = dim[2];
+
+	  return M * N * (K + K - 1u);
+}
+
+
+/*! Traffic function of the Pass.
+ *
+ * Every panel is a tiled product with K = P. All panels but the first also read dst.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W, size_t P, size_t Margin>
+Traffic PanelPass<Type_,W,P,Margin>::traffic( utl::Dim const& dim ) const
+{
+	  size_t const M = dim[0];
+	  size_t const N = dim[1];
+	  size_t const K = dim[2];
+
+	  const double panels = double( K / P );
+
+	  Traffic t = tiledTraffic<Type>( M, N, P, W ) * panels;
+	  t.reads += double( sizeof (Type) ) * M * N * (panels - 1.0);
+	  return t;
+}
+
+#endif
@@ -3,24 +3,75 @@
 #include <stdexcept>
 #include <memory>
 #include <istream>
+#include <vector>
+#include <string>
 
 #include <ocl_wrapper.h>
 #include <utl_utils.h>
 
 #include "profile.h"
+#include "gemv.h"
+#include "spmm.h"
+#include "strassen.h"
+#include "panel.h"
+#include "executorpass.h"
+#include "epilogue.h"
+#include "generated.h"
+#include "matfile.h"
+#include "device.h"
 
 
 
 int main( int argc, char** argv )
 {
-    utl::Args args( argc, argv );
+	// Options are taken out before the positional arguments are handed to utl::Args.
+	std::vector<char*> positional;
+	std::vector<KernelSpec> specs;
+	std::string lhsFile, rhsFile;
+	for ( int i = 0; i < argc; ++i )
+	{
+		const std::string arg = argv[i];
+		if ( arg == "--kernel" && i + 1 < argc ) { specs.push_back( KernelSpec::parse( argv[++i] ) ); continue; }
+		if ( arg == "--lhs" && i + 1 < argc )    { lhsFile = argv[++i]; continue; }
+		if ( arg == "--rhs" && i + 1 < argc )    { rhsFile = argv[++i]; continue; }
+		positional.push_back( argv[i] );
+	}
 
-    size_t const numArgs = args.size();
+    utl::Args args( int( positional.size() ), positional.data() );
 
-	if ( numArgs != 4 && numArgs != 5) {std::cerr << "Usage: " << args.at( 0 ) << " dimStart dimEnd dimStep <testing>" << std::endl; return EXIT_FAILURE;}
+    size_t const numArgs = args.size();
 
 	utl::ProfilePassManager mgr;
 
+	// Captured operands, see matfile.h. The dimension is given by the files, so only the dense kernels are profiled once.
+	if ( !lhsFile.empty() || !rhsFile.empty() )
+	{
+		if ( lhsFile.empty() || rhsFile.empty() || numArgs > 2 ) {std::cerr << "Usage: " << args.at( 0 ) << " --lhs file --rhs file <testing>" << std::endl; return EXIT_FAILURE;}
+		bool testing = numArgs == 2 ? args.toBool(1) : false;
+
+		auto const lhs = std::make_shared<const MappedMatrix>( lhsFile );
+		auto const rhs = std::make_shared<const MappedMatrix>( rhsFile );
+		for ( const auto& m : { lhs, rhs } )
+			if ( m->header().type != MatrixFileHeader::Float ) {std::cerr << m->file() << " should hold float values, the profiled kernels are instantiated for float" << std::endl; return EXIT_FAILURE;}
+		if ( lhs->cols() != rhs->rows() ) {std::cerr << "Inner dimensions of " << lhsFile << " and " << rhsFile << " differ" << std::endl; return EXIT_FAILURE;}
+
+		const utl::Dim dim = utl::Dim( lhs->rows(), rhs->cols(), lhs->cols() );
+		if ( dim[0] % 16 || dim[1] % 16 || dim[2] % 16 ) {std::cerr << "Dimensions " << dim[0] << "x" << dim[2] << " and " << dim[2] << "x" << dim[1] << " should be multiples of the tile size 16" << std::endl; return EXIT_FAILURE;}
+
+		for ( const std::string kernel : { "multiplyr", "multiplyr_db" } )
+		{
+			auto pass = new StudXPass1<float,utl::row_major_tag,16u,16u>( "./profile1.cl", kernel, dim, dim, dim, testing, 10 );
+			pass->setInputs( lhs, rhs );
+			mgr << pass;
+		}
+
+		mgr.run();
+		mgr.write( std::cout );
+		return EXIT_SUCCESS;
+	}
+
+	if ( numArgs != 4 && numArgs != 5) {std::cerr << "Usage: " << args.at( 0 ) << " dimStart dimEnd dimStep <testing> [--kernel \"TM=32,TN=32,VW=4,...\"]..." << std::endl; return EXIT_FAILURE;}
+
 	size_t const f  = args.toSizet( 1 );
 	size_t const l  = args.toSizet( 2 );
 	size_t const s  = args.toSizet( 3 );
@@ -30,10 +81,43 @@ int main( int argc, char** argv )
 	const utl::Dim last  = utl::Dim(l,l,l);
 	const utl::Dim step  = utl::Dim(s,s,s);
 
+	const utl::Dim firstv = utl::Dim(f,f,1);
+	const utl::Dim lastv  = utl::Dim(l,l,1);
+	const utl::Dim stepv  = utl::Dim(s,s,1);
+
 //	mgr << new StudXPass1<float,utl::row_major_tag,16u,16u>    ("./profile1.cl","multiplycs", first, step, last, testing, 10);
 	mgr << new StudXPass1<float,utl::row_major_tag,16u,16u>    ("./profile1.cl","multiplyr", first, step, last, testing, 10);
+	mgr << new StudXPass1<float,utl::row_major_tag,16u,16u>    ("./profile1.cl","multiplyr_db", first, step, last, testing, 10);
 //	mgr << new StudXPass1<float,utl::column_major_tag,16u,16u> ("./profile1.cl","multiplyc", first, step, last, testing, 10);
 
+	mgr << new GemvPass<float,utl::row_major_tag,64u,4u,1u>    ("./gemv.cl","matvec2_rmajor", firstv, stepv, lastv, testing, 10);
+	mgr << new GemvPass<float,utl::row_major_tag,64u,4u,4u>    ("./gemv.cl","matvec2_rmajor", firstv, stepv, lastv, testing, 10);
+	mgr << new GemvPass<float,utl::column_major_tag,64u,4u,1u> ("./gemv.cl","matvec2_cmajor", firstv, stepv, lastv, testing, 10);
+	mgr << new GemvPass<float,utl::column_major_tag,64u,4u,4u> ("./gemv.cl","matvec2_cmajor", firstv, stepv, lastv, testing, 10);
+
+	for ( double density : { 0.01, 0.05, 0.2 } )
+		mgr << new SpmmPass<float,64u>                           ("./spmm.cl","spmm_csr_rmajor", density, first, step, last, testing, 10);
+
+	mgr << new StrassenPass<float,16u>                           ("./strassen.cl", 2, 512, first, step, last, testing, 10);
+	// The panel width 64 divides every profiled K only if it divides the first one and the step.
+	if ( f % 64 == 0 && s % 64 == 0 )
+		mgr << new PanelPass<float,16u,64u,16u>                  ("./view.cl", first, step, last, testing, 10);
+	if ( hasDevice( CL_DEVICE_TYPE_CPU ) )
+		mgr << new ExecutorPass<float,16u>                       ("./executor.cl", ocl::device_type::CPU, 16, 8, 4, first, step, last, testing, 10);
+
+	mgr << new EpiloguePass<float,16u>                           ("./epilogue.cl", Epilogue::rowSums(),   true,  first, step, last, testing, 10);
+	for ( const Epilogue& epilogue : { Epilogue::rowSums(), Epilogue::rowNorms(), Epilogue::colMax(), Epilogue::frobenius() } )
+		mgr << new EpiloguePass<float,16u>                       ("./epilogue.cl", epilogue,              false, first, step, last, testing, 10);
+
+	// Generated kernels, see kernelgen.h. Without --kernel the generated counterpart of multiplyr and a register-blocked variant.
+	if ( specs.empty() )
+	{
+		specs.push_back( KernelSpec::parse( "name=multiplyr_gen" ) );
+		specs.push_back( KernelSpec::parse( "name=multiplyr_gen4,TM=32,TN=32,TK=8,VW=4" ) );
+	}
+	for ( const KernelSpec& spec : specs )
+		mgr << new GeneratedPass<float>                          ( spec, first, step, last, testing, 10 );
+
     mgr.run();
     mgr.write( std::cout );
     
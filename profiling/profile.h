@@ -5,10 +5,15 @@
 #include <stdexcept>
 #include <memory>
 #include <istream>
+#include <algorithm>
 
 #include <ocl_wrapper.h>
 #include <utl_utils.h>
 
+#include "roofline.h"
+#include "verify.h"
+#include "matfile.h"
+
 
 ///////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////
@@ -21,9 +26,9 @@
  * \param Format_ is the storage type of the matrices. Here we use row or column-major format.
 */
 template <class Type_,class Format_ , size_t W1, size_t W2>
-class StudXPass1 : public utl::ProfilePass
+class StudXPass1 : public RooflinePass
 {
-	using Base   = utl::ProfilePass;
+	using Base   = RooflinePass;
 	using Type   = Type_;
 	using Format = Format_;
 	using Rand   = utl::Rand  < Type, Format, utl::uniform_dist_tag >;
@@ -45,8 +50,9 @@ public :
 			   const Dim& start,              /*! First dimension e.g. Dim(128,128,128) with Dim[0]=M, Dim[1]=N, Dim[2]=K, */
 			   const Dim& step,               /*! Step dimension e.g. Dim(32,32,32) such that this pass iterates from first to last dimension */
 			   const Dim& end,                /*! Last dimension e.g. Dim(256,256,256) with Dim[0]=M, Dim[1]=N, Dim[2]=K, */
-			   bool testing = false,          /*! If true, compares the cpu reference result to the gpu result */
-			   size_t iter = 10);             /*! Number of kernel iterations */
+			   bool testing = false,          /*! If true, verifies the gpu result, see verify.h */
+			   size_t iter = 10,              /*! Number of kernel iterations */
+			   DeviceType type = ocl::device_type::GPU); /*! Device type, e.g. ocl::device_type::CPU for PoCL */
 
 	/*! This function needs to be defined so that it can be called from the pass manager. */
 	utl::Seconds prof( Dim const& ) override;
@@ -54,8 +60,16 @@ public :
 	/*! This function needs to be defined so that it can be called from the pass manager. */
 	double ops( Dim const& ) override;
 
+	/*! Bytes moved by the kernel. multiplycs reads both operands element by element, all others are tiled. */
+	Traffic traffic( Dim const& ) const override;
+
+	/*! Uses the operands of mapped files instead of random ones. They are uploaded in every prof() call, so the dimensions must match. */
+	void setInputs( std::shared_ptr<const MappedMatrix> lhs, std::shared_ptr<const MappedMatrix> rhs ) { lhsFile_ = lhs; rhsFile_ = rhs; }
+
 private :
 
+	static constexpr size_t STRESS = 32; /*! Number of repeated runs compared in testing mode */
+
 	std::string name(const std::string& kernel) const
 	{
 		std::ostringstream oss;
@@ -65,12 +79,16 @@ private :
 
 
 	bool testing_;
-	ocl::Platform platform_; /*! Platform is selected here as GPU. Initialized in the constructor */
+	bool tiled_;             /*! False for the untiled multiplycs kernel. */
+	ocl::Platform platform_; /*! Platform of the device type given to the constructor. Initialized in the constructor */
 	ocl::Device   device_;   /*! The first Device is chosen. Initialized in the constructor */
 	ocl::Context  context_;  /*! Only one Context is created. Initialized in the constructor */
 	ocl::Queue    queue_;    /*! Only one Queue is created with the above Context and Device. Initialized in the constructor */
 	ocl::Program  program_;  /*! Program is created in the constructor but built in the prof() function with dimension parameters.*/
 	ocl::Kernel*  kernel_;   /*! Kernel is created in the constructor but built in the prof() function. */
+	Roofline<Type> roofline_; /*! Peaks of the device. Measured in the constructor */
+	std::shared_ptr<const MappedMatrix> lhsFile_; /*! Optional operand files, see setInputs() */
+	std::shared_ptr<const MappedMatrix> rhsFile_;
 };
 
 
@@ -86,15 +104,18 @@ StudXPass1<Type_,Format_,W1,W2>::StudXPass1(
 		const utl::Dim& step,
 		const utl::Dim& end,
 		bool testing,
-		size_t iter) :
+		size_t iter,
+		DeviceType type) :
 	  Base(this->name(kernel), start, step, end, testing ? 1 : iter),
 	  testing_(testing),
-	  platform_( ocl::device_type::GPU ),
-	  device_( platform_.device( ocl::device_type::GPU ) ),
+	  tiled_(kernel != "multiplycs"),
+	  platform_( type ),
+	  device_( platform_.device( type ) ),
 	  context_( device_ ),
 	  queue_( context_, device_, CL_QUEUE_PROFILING_ENABLE ),
 	  program_( context_, utl::type::Single | utl::type::Double ),
-	  kernel_(nullptr)
+	  kernel_(nullptr),
+	  roofline_( context_, queue_, type )
 {
 	std::ifstream stream( file );
 	if ( !stream.is_open() ) { throw std::runtime_error("Failed opening file " + file);}
@@ -107,9 +128,11 @@ StudXPass1<Type_,Format_,W1,W2>::StudXPass1(
 
 /*! Profile function of the Pass. This file must be changed according to your needs.
  *
- * \note It shall alse provide a testing possibility.
+ * \note It shall alse provide a testing possibility. In testing mode the kernel is run
+ *       STRESS more times on the same operands. A race on local memory shows up as
+ *       results which differ from run to run even if one of them passes verification.
  * \note You do not have to invoke this function. The PassManager does everything.
- *       Just be sure to call the this->call(f) function. See below.
+ *       Just be sure to call the this->profile(f, dim, roofline_) function. See below.
  *
  * \param dim Dimension which is between the first and the last.
 */
@@ -125,6 +148,8 @@ utl::Seconds StudXPass1<Type_,Format_, W1,W2>::prof( utl::Dim const& dim )
 
 	  if( N <= 0 ) throw std::runtime_error( "N should be greater 0." );
 	  if( M <= 0 ) throw std::runtime_error( "M should be greater 0." );
+	  // The tiled kernels skip partial tiles instead of padding them.
+	  if( tiled_ && ( M % W1 || N % W1 || K % W1 ) ) throw std::runtime_error( "M, N and K should be multiples of W1." );
 
 	  std::ostringstream oss;
 	  oss << "-w -Werror" << " -D M=" << M << "u -D N=" << N << "u -D W=" << W1 << "u -D K=" << K << 'u';
@@ -134,7 +159,8 @@ utl::Seconds StudXPass1<Type_,Format_, W1,W2>::prof( utl::Dim const& dim )
 	  if ( ! program_.isBuilt() ) { throw std::runtime_error( "program not built" ); }
 	  if ( ! kernel_->created() ) { throw std::runtime_error( "kernel not created" ); }
 
-	  kernel_->setWorkSize( W1, W2, M, N );
+	  // Axis 0 walks the columns of dst, axis 1 its rows.
+	  kernel_->setWorkSize( W1, W2, (N + W1 - 1) / W1 * W1, (M + W2 - 1) / W2 * W2 );
 
 	  const size_t numResBytes = sizeof (Type) * M * N;
 	  const size_t numLhsBytes = sizeof (Type) * M * K;
@@ -148,7 +174,19 @@ utl::Seconds StudXPass1<Type_,Format_, W1,W2>::prof( utl::Dim const& dim )
 
 	  Matrix lhs;
 	  Matrix rhs;
-	  if(testing_){
+	  if(lhsFile_ && rhsFile_){
+		  if( lhsFile_->rows() != M || lhsFile_->cols() != K || rhsFile_->rows() != K || rhsFile_->cols() != N )
+			  throw std::runtime_error( "operand files do not match the dimension." );
+
+		  constexpr bool rowMajor = std::is_same<Format, utl::row_major_tag>::value;
+		  upload<Type>( *lhsFile_, bufLhs, queue_, rowMajor );
+		  upload<Type>( *rhsFile_, bufRhs, queue_, rowMajor );
+		  if(testing_){
+			  lhs = toMatrix<Type,Format>( *lhsFile_ );
+			  rhs = toMatrix<Type,Format>( *rhsFile_ );
+		  }
+	  }
+	  else if(testing_){
 		  lhs = Rand (M, K);
 		  rhs = Rand (K, N);
 		  /*	
@@ -167,25 +205,26 @@ utl::Seconds StudXPass1<Type_,Format_, W1,W2>::prof( utl::Dim const& dim )
 		  queue.finish();
 	  };
 
-	  auto t = this->call(std::bind(lambda, std::ref(*kernel_), std::ref(queue_), std::ref(bufRes), std::cref(bufLhs), std::cref(bufRhs)));
+	  auto t = this->profile(std::bind(lambda, std::ref(*kernel_), std::ref(queue_), std::ref(bufRes), std::cref(bufLhs), std::cref(bufRhs)), dim, roofline_);
 
 	  if( testing_ )
 	  {
 		  Matrix res = Zeros( M, N );
 		  bufRes.read( queue_, 0u, res.data(), numResBytes);
 
-		  auto const ref  = lhs * rhs;
-		  auto const diff = res - ref;
-		  auto const iMax = std::max_element( diff.begin(), diff.end(), []( Type a, Type b ){ return std::fabs( a ) < std::fabs( b ); } );
-	
-		  std::cout << "lhs = " << lhs << std::endl << "rhs = " << rhs << std::endl << "ref = " << ref << std::endl << "res = " << res << std::endl;
+		  verify( lhs, rhs, res ).report( std::cout );
 
-		  std::cout << "Maximal error: " << *iMax << std::endl;
-		  if ( *iMax != 0 )
+		  Matrix again = Zeros( M, N );
+		  size_t differ = 0;
+		  for ( size_t r = 0; r < STRESS; ++r )
 		  {
-			  size_t const index = iMax - diff.begin();
-			  std::cout << "ref[" << index << "] = " << ref[index] << " != res[" << index << "] = " << res[index] << std::endl;
+			  (*kernel_)( queue_, bufRes.id(), bufLhs.id(), bufRhs.id() );
+			  queue_.finish();
+			  bufRes.read( queue_, 0u, again.data(), numResBytes);
+			  if ( !std::equal( res.begin(), res.end(), again.begin() ) ) ++differ;
 		  }
+		  std::cout << "Stress: " << differ << " of " << STRESS << " runs differ from the first" << std::endl;
+		  if ( differ ) ++failedChecks();
 	  }
 
 
@@ -213,4 +252,21 @@ double StudXPass1<Type_,Format_, W1,W2>::ops( utl::Dim const& dim )
 	  // return M * (N + (N - 1u));
 }
 
+
+/*! Traffic function of the Pass.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_,class Format_ , size_t W1, size_t W2>
+Traffic StudXPass1<Type_,Format_, W1,W2>::traffic( utl::Dim const& dim ) const
+{
+	  size_t const M = dim[0];
+	  size_t const N = dim[1];
+	  size_t const K = dim[2];
+
+	  if ( tiled_ ) return tiledTraffic<Type>( M, N, K, W1 );
+
+	  return Traffic( double( sizeof (Type) ) * 2.0 * M * N * K, double( sizeof (Type) ) * M * N );
+}
+
 #endif
@@ -98,15 +98,55 @@ __kernel void multiplyr(__global TYPE *dst, __global TYPE *src1, __global TYPE *
         As[l_row][l_col] = src1[(g_row * W + l_row) * K + (j * W + l_col)];
         Bs[l_row][l_col] = src2[(j * W + l_row) * N + (g_col * W + l_col)];
 
-        // barrier(CLK_LOCAL_MEM_FENCE);
+        barrier(CLK_LOCAL_MEM_FENCE);
 	
         for (int e = 0; e < W; ++e) {
             c_value += As[l_row][e] * Bs[e][l_col];
 	}
-        // barrier(CLK_LOCAL_MEM_FENCE);
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    dst[(g_row * W + l_row) * N + g_col * W + l_col] = c_value;
+}
+
+// multiplyr with two local tiles per operand. Tile j+1 is loaded while tile j is
+// multiplied, so the global loads overlap with the inner loop. Buffer j&1 is read in
+// iteration j and written in iteration j+1 only after the barrier at the end of j, so
+// one barrier per tile suffices.
+template<class TYPE>
+__kernel void multiplyr_db(__global TYPE *dst, __global TYPE *src1, __global TYPE *src2)
+{
+    __local TYPE As[2][W][W];
+    __local TYPE Bs[2][W][W];
+
+    unsigned int g_col = get_group_id(0);
+    unsigned int g_row = get_group_id(1);
+
+    unsigned int l_col = get_local_id(0);
+    unsigned int l_row = get_local_id(1);
+
+    if(g_col >= N / W || g_row >= M / W || l_col >= W || l_row >= W)
+        return;
+
+    TYPE c_value = 0;
+
+    As[0][l_row][l_col] = src1[(g_row * W + l_row) * K + l_col];
+    Bs[0][l_row][l_col] = src2[l_row * N + (g_col * W + l_col)];
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int j = 0; j < (K / W); ++j) {
+        const int cur = j & 1;
+
+        if (j + 1 < (K / W)) {
+            As[cur ^ 1][l_row][l_col] = src1[(g_row * W + l_row) * K + ((j + 1) * W + l_col)];
+            Bs[cur ^ 1][l_row][l_col] = src2[((j + 1) * W + l_row) * N + (g_col * W + l_col)];
+        }
+
+        for (int e = 0; e < W; ++e) {
+            c_value += As[cur][l_row][e] * Bs[cur][e][l_col];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
     }
-    // dst[0] = 1; // c_value;
-    // dst[(g_row * W + l_row) * N + g_col * W + l_col] = 1; // c_value;
     dst[(g_row * W + l_row) * N + g_col * W + l_col] = c_value;
 }
 
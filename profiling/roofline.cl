@@ -0,0 +1,33 @@
+
+// Micro-benchmarks of roofline.h which measure the peaks of a device.
+
+
+// Streams COUNT elements from src to dst.
+template<class Type>
+__kernel void stream_copy(__global Type *dst, __global Type *src)
+{
+	const size_t i = get_global_id(0);
+
+	if(i >= COUNT) return;
+
+	dst[i] = src[i];
+}
+
+// Every thread runs 8 independent chains of REPS multiply-adds, which is 16*REPS
+// operations without a memory access. The sum is stored so that nothing is optimized away.
+template<class Type>
+__kernel void fma_chain(__global Type *dst, Type a, Type b)
+{
+	const size_t i = get_global_id(0);
+
+	Type x0 = i, x1 = i + 1, x2 = i + 2, x3 = i + 3;
+	Type x4 = i + 4, x5 = i + 5, x6 = i + 6, x7 = i + 7;
+
+	for(int r = 0; r < REPS; ++r)
+	{
+		x0 = mad(x0, a, b); x1 = mad(x1, a, b); x2 = mad(x2, a, b); x3 = mad(x3, a, b);
+		x4 = mad(x4, a, b); x5 = mad(x5, a, b); x6 = mad(x6, a, b); x7 = mad(x7, a, b);
+	}
+
+	dst[i] = x0 + x1 + x2 + x3 + x4 + x5 + x6 + x7;
+}
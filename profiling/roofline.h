@@ -0,0 +1,356 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <istream>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <ocl_wrapper.h>
+#include <utl_utils.h>
+
+#include "device.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+/*! Bytes moved by one kernel execution as requested by the kernel, i.e. before caches. */
+struct Traffic
+{
+	double reads;  /*! Bytes read from global memory */
+	double writes; /*! Bytes written to global memory */
+	double local;  /*! Bytes read from and written to local memory */
+
+	Traffic() : reads(0), writes(0), local(0) {}
+	Traffic(double reads, double writes, double local = 0) : reads(reads), writes(writes), local(local) {}
+
+	double global() const { return reads + writes; }
+
+	Traffic& operator+=( const Traffic& other ) { reads += other.reads; writes += other.writes; local += other.local; return *this; }
+	Traffic  operator* ( double factor ) const { return Traffic( reads * factor, writes * factor, local * factor ); }
+};
+
+
+/*! Traffic of the W x W tiled kernels (multiplyr, multiplyc, ...) for dst = src1 * src2.
+ *
+ * Every work-group reads a W x K panel of src1 and a K x W panel of src2. Every thread
+ * stores 2 elements per tile into local memory and reads 2*W elements back.
+*/
+template <class Type>
+Traffic tiledTraffic( size_t M, size_t N, size_t K, size_t W )
+{
+	const double s = sizeof (Type);
+	const double tiles = double( K ) / W;
+	return Traffic( s * 2.0 * M * N * tiles, s * M * N, s * M * N * tiles * (2.0 + 2.0 * W) );
+}
+
+
+/*! Hardware counters of the threads of the calling process via perf_event_open.
+ *
+ * Only useful for OpenCL devices which execute on the host CPU. The kernels run on threads
+ * of the OpenCL runtime, and those exist before any counter is opened. So one set of
+ * counters is opened for every thread listed in /proc/self/task, each with inherit set,
+ * so that threads created afterwards are included as well. Per-thread counters only need
+ * a perf_event_paranoid of at most 2, the default of most distributions, and do not count
+ * other processes. If they cannot be opened, e.g. on other systems, available() returns false.
+*/
+class PerfCounters
+{
+public :
+	enum Event { Cycles, Instructions, CacheReferences, CacheMisses, NumEvents };
+
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	/*! Opens the counters for every thread of the process if enable is true. */
+	explicit PerfCounters(bool enable)
+	{
+		std::fill( values_, values_ + NumEvents, uint64_t(0) );
+#if defined(__linux__)
+		if ( !enable ) return;
+		const uint64_t configs[NumEvents] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+											  PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES };
+		DIR* tasks = opendir( "/proc/self/task" );
+		if ( !tasks ) return;
+		while ( const dirent* entry = readdir( tasks ) )
+		{
+			const int tid = std::atoi( entry->d_name );
+			if ( tid <= 0 ) continue; // . and ..
+			const size_t first = fd_.size();
+			for ( int e = 0; e < NumEvents; ++e )
+			{
+				perf_event_attr attr;
+				std::memset( &attr, 0, sizeof attr );
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.size = sizeof attr;
+				attr.config = configs[e];
+				attr.disabled = 1;
+				attr.inherit = 1;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				const int fd = int( syscall( __NR_perf_event_open, &attr, tid, -1, -1, 0 ) );
+				if ( fd >= 0 ) { fd_.push_back( fd ); continue; }
+				if ( errno == ESRCH ) // the thread exited meanwhile
+				{
+					for ( size_t i = first; i < fd_.size(); ++i ) ::close( fd_[i] );
+					fd_.resize( first );
+					break;
+				}
+				closedir( tasks );
+				close();
+				return;
+			}
+		}
+		closedir( tasks );
+#else
+		(void) enable;
+#endif
+	}
+
+	~PerfCounters() { close(); }
+
+	bool available() const { return !fd_.empty(); }
+
+	void start()
+	{
+#if defined(__linux__)
+		for ( int fd : fd_ ) { ioctl( fd, PERF_EVENT_IOC_RESET, 0 ); ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 ); }
+#endif
+	}
+
+	/*! Stops the counters and sums them over all threads. */
+	void stop()
+	{
+		std::fill( values_, values_ + NumEvents, uint64_t(0) );
+#if defined(__linux__)
+		for ( size_t i = 0; i < fd_.size(); ++i )
+		{
+			uint64_t value = 0;
+			ioctl( fd_[i], PERF_EVENT_IOC_DISABLE, 0 );
+			if ( read( fd_[i], &value, sizeof value ) == ssize_t( sizeof value ) ) values_[i % NumEvents] += value;
+		}
+#endif
+	}
+
+	uint64_t value( Event e ) const { return values_[e]; }
+
+	double ipc() const { return values_[Cycles] ? double( values_[Instructions] ) / double( values_[Cycles] ) : 0.0; }
+
+	double missRate() const { return values_[CacheReferences] ? double( values_[CacheMisses] ) / double( values_[CacheReferences] ) : 0.0; }
+
+private :
+	/*! Closes all counters. A partial set of counters is of no use, so available() becomes false. */
+	void close()
+	{
+#if defined(__linux__)
+		for ( int fd : fd_ ) ::close( fd );
+#endif
+		fd_.clear();
+	}
+
+	std::vector<int> fd_; /*! NumEvents counters per thread, ordered by thread */
+	uint64_t values_[NumEvents];
+};
+
+
+/*! Peak bandwidth and operation rate of a device, measured with the kernels of roofline.cl.
+ *
+ * The peaks are measured by the first Roofline of a device and value type: the bandwidth
+ * with a copy of COUNT elements, the operation rate with independent multiply-add chains.
+ * The best of a few runs is kept. Further Rooflines of the device, e.g. of the other
+ * passes, take the cached peaks.
+ *
+ * \param Type_ is the value type the operation rate is measured for.
+*/
+template <class Type_>
+class Roofline
+{
+	using Type  = Type_;
+	using Timer = utl::Timer < utl::MilliSeconds >;
+
+	static constexpr size_t COUNT   = size_t(1) << 24;
+	static constexpr size_t THREADS = size_t(1) << 18;
+	static constexpr size_t REPS    = 512;
+	static constexpr size_t RUNS    = 5;
+public :
+	using DeviceType = decltype( ocl::device_type::GPU );
+
+	Roofline() = delete;
+	Roofline(const Roofline&) = default;
+
+	Roofline(ocl::Context& context,                          /*! Context of the pass */
+			 ocl::Queue& queue,                              /*! Queue of the pass */
+			 DeviceType type,                                /*! Device type of the pass. Counters are only read for CPU devices */
+			 const std::string& file = "./roofline.cl");     /*! Name of the *.cl file with the micro-benchmarks */
+
+	/*! Peak bandwidth in bytes per second. */
+	double bandwidth() const { return bandwidth_; }
+
+	/*! Peak rate in operations per second. */
+	double flops() const { return flops_; }
+
+	/*! True if the device is the host CPU. */
+	bool cpu() const { return cpu_; }
+
+	/*! Writes intensity, achieved rates and the fraction of the roofline for one kernel execution. */
+	void report( std::ostream& os, double ops, const Traffic& traffic, utl::Seconds t ) const;
+
+private :
+	using Key   = std::pair< cl_device_id, std::string >;
+	using Peaks = std::pair< double, double >;
+
+	/*! Peaks measured so far by device and *.cl file. */
+	static std::map<Key, Peaks>& cache()
+	{
+		static std::map<Key, Peaks> peaks;
+		return peaks;
+	}
+
+	/*! Measures bandwidth and operation rate on the device of queue. */
+	static Peaks measure( ocl::Context& context, ocl::Queue& queue, const std::string& file );
+
+	template <class F>
+	static double best( F f )
+	{
+		double ms = 0;
+		for ( size_t r = 0; r < RUNS; ++r )
+		{
+			Timer::tic(); f(); Timer::toc();
+			ms = r == 0 ? Timer::elapsed().count() : std::min( ms, double( Timer::elapsed().count() ) );
+		}
+		return ms * 1e-3;
+	}
+
+	double bandwidth_;
+	double flops_;
+	bool cpu_;
+};
+
+
+template <class Type_>
+Roofline<Type_>::Roofline(ocl::Context& context, ocl::Queue& queue, DeviceType type, const std::string& file) :
+	bandwidth_( 0 ),
+	flops_( 0 ),
+	cpu_( type == ocl::device_type::CPU )
+{
+	static std::mutex mutex;
+	std::lock_guard<std::mutex> lock( mutex );
+
+	const Key key( deviceOf( queue ), file );
+	auto it = cache().find( key );
+	if ( it == cache().end() ) it = cache().emplace( key, measure( context, queue, file ) ).first;
+
+	bandwidth_ = it->second.first;
+	flops_     = it->second.second;
+}
+
+
+template <class Type_>
+typename Roofline<Type_>::Peaks Roofline<Type_>::measure(ocl::Context& context, ocl::Queue& queue, const std::string& file)
+{
+	ocl::Program program( context, utl::type::Single | utl::type::Double );
+
+	std::ifstream stream( file );
+	if ( !stream.is_open() ) { throw std::runtime_error("Failed opening file " + file);}
+	program << stream;
+
+	ocl::Kernel& copy = program.kernel("stream_copy", utl::Type::type<Type>());
+	ocl::Kernel& fma  = program.kernel("fma_chain",   utl::Type::type<Type>());
+
+	std::ostringstream oss;
+	oss << "-w -Werror" << " -D COUNT=" << COUNT << "u -D REPS=" << REPS;
+
+	program.setCompileOption( ocl::CompileOption( oss.str() ) );
+	program.build();
+	if ( ! program.isBuilt() ) { throw std::runtime_error( "program not built" ); }
+
+	ocl::Buffer src( context, sizeof (Type) * COUNT, ocl::Buffer::ReadOnly );
+	ocl::Buffer dst( context, sizeof (Type) * COUNT, ocl::Buffer::WriteOnly );
+
+	copy.setWorkSize( 256, COUNT );
+	fma.setWorkSize( 256, THREADS );
+
+	const double tCopy = best( [&]{ copy( queue, dst.id(), src.id() ); queue.finish(); } );
+	const double tFma  = best( [&]{ fma( queue, dst.id(), Type( 0.999 ), Type( 0.001 ) ); queue.finish(); } );
+
+	program.release();
+
+	return Peaks( 2.0 * sizeof (Type) * COUNT / tCopy, 16.0 * REPS * THREADS / tFma );
+}
+
+
+template <class Type_>
+void Roofline<Type_>::report( std::ostream& os, double ops, const Traffic& traffic, utl::Seconds t ) const
+{
+	const double seconds    = t.count();
+	const double intensity  = ops / traffic.global();
+	const double achieved   = ops / seconds;
+	const double attainable = std::min( flops_, intensity * bandwidth_ );
+
+	os << "Roofline: intensity[flop/B]=" << intensity
+	   << ", GB/s=" << traffic.global() / seconds * 1e-9 << " of " << bandwidth_ * 1e-9
+	   << ", local GB/s=" << traffic.local / seconds * 1e-9
+	   << ", GFLOP/s=" << achieved * 1e-9 << " of " << flops_ * 1e-9
+	   << ", " << ( intensity * bandwidth_ < flops_ ? "memory" : "compute" ) << "-bound"
+	   << ", roofline=" << 100.0 * achieved / attainable << "%" << std::endl;
+}
+
+
+/*! ProfilePass which declares the traffic of its kernel and reports it against the roofline of its device.
+ *
+ * Derived passes implement traffic() and call profile() instead of call().
+*/
+class RooflinePass : public utl::ProfilePass
+{
+public :
+	using utl::ProfilePass::ProfilePass;
+
+	/*! Bytes moved by one kernel execution for the given dimension. */
+	virtual Traffic traffic( utl::Dim const& ) const = 0;
+
+protected :
+	/*! Calls f like call() and writes the roofline report and, on CPU devices, the hardware counters. */
+	template <class Type, class F>
+	utl::Seconds profile( F&& f, utl::Dim const& dim, const Roofline<Type>& roofline )
+	{
+		PerfCounters counters( roofline.cpu() );
+
+		counters.start();
+		auto t = this->call( std::forward<F>( f ) );
+		counters.stop();
+
+		roofline.report( std::cout, this->ops( dim ), this->traffic( dim ), t );
+
+		if ( counters.available() )
+		{
+			std::cout << "Counters: IPC=" << counters.ipc()
+					  << ", cache misses=" << counters.value( PerfCounters::CacheMisses )
+					  << " (" << 100.0 * counters.missRate() << "% of references)" << std::endl;
+		}
+
+		return t;
+	}
+};
+
+#endif
@@ -0,0 +1,49 @@
+
+// dst Zeros( M, N );
+// A     Csr( M, K ) given by rowPtr, colIdx and val
+// B    Rand( K, N );
+//
+// All matrices are stored in row-major format.
+
+
+// Work-group (g_col, m) is responsible to calculate W consecutive elements of row m of dst.
+// The nonzeros of row m are staged into local memory W at a time, so every nonzero is
+// fetched once per work-group. Thread n, thread n+1 then address contiguous row elements
+// of B -> coalesced memory access. The work of a group scales with the nonzeros of its
+// row only, so empty rows cost one rowPtr read.
+template<class Type>
+__kernel void spmm_csr_rmajor(__global Type *dst, __global uint *rowPtr, __global uint *colIdx, __global Type *val, __global Type *B)
+{
+    __local uint Cs[W];
+    __local Type Vs[W];
+
+    const unsigned int n = get_global_id(0);
+    const unsigned int m = get_group_id(1);
+    const unsigned int l = get_local_id(0);
+
+    if(m >= M) return;
+
+    const unsigned int begin = rowPtr[m];
+    const unsigned int end   = rowPtr[m + 1];
+
+    Type c_value = 0;
+
+    for (unsigned int j = begin; j < end; j += W) {
+        if(j + l < end) {
+            Cs[l] = colIdx[j + l];
+            Vs[l] = val[j + l];
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        const unsigned int count = min((unsigned int)W, end - j);
+        if(n < N)
+            for (unsigned int e = 0; e < count; ++e)
+                c_value += Vs[e] * B[Cs[e] * N + n];
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if(n < N)
+        dst[m * N + n] = c_value;
+}
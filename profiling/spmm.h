@@ -0,0 +1,285 @@
+#ifndef SPMMPASS_H
+#define SPMMPASS_H
+
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <istream>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include <ocl_wrapper.h>
+#include <utl_utils.h>
+
+#include "roofline.h"
+#include "verify.h"
+#include "csr.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+/*! SpmmPass profiles the sparse times dense kernel of spmm.cl and is managed by the PassManager.
+ *
+ * The left-hand side is a random matrix of which only a fraction (the density) of the
+ * entries is kept. It is converted to Csr on the host and only the Csr arrays are uploaded.
+ * Register one pass per density next to the dense StudXPass1 with multiplyr to compare both.
+ *
+ * \param Type_ is the value type of the matrices. Here we use float,double or int. other types are also possible
+ * \param W is the number of columns of the result computed by one work-group.
+*/
+template <class Type_, size_t W>
+class SpmmPass : public RooflinePass
+{
+	using Base   = RooflinePass;
+	using Type   = Type_;
+	using Format = utl::row_major_tag;
+	using Rand   = utl::Rand  < Type, Format, utl::uniform_dist_tag >;
+	using Zeros  = utl::Zeros < Type, Format >;
+	using Matrix = utl::Matrix< Type, Format >;
+	using Sparse = Csr< Type >;
+	using Dim    = utl::Dim;
+	using Timer  = utl::Timer < utl::MilliSeconds >;
+public :
+
+	SpmmPass() = delete;
+	SpmmPass(const SpmmPass&) = default;
+	SpmmPass(SpmmPass&&) = default;
+	~SpmmPass() = default;
+
+
+	/*! This is the constructor one should use to initialize the platform. */
+	SpmmPass(const std::string& filename,   /*! Name of the *.cl file */
+			 const std::string& kernelname, /*! Kernel name within the *.cl file */
+			 double density,                /*! Fraction of nonzero entries of the left-hand side, between 0 and 1 */
+			 const Dim& start,              /*! First dimension e.g. Dim(128,128,128) with Dim[0]=M, Dim[1]=N, Dim[2]=K, */
+			 const Dim& step,               /*! Step dimension e.g. Dim(32,32,32) such that this pass iterates from first to last dimension */
+			 const Dim& end,                /*! Last dimension e.g. Dim(256,256,256) with Dim[0]=M, Dim[1]=N, Dim[2]=K, */
+			 bool testing = false,          /*! If true, verifies the gpu result, see verify.h */
+			 size_t iter = 10,              /*! Number of kernel iterations */
+			 DeviceType type = ocl::device_type::GPU); /*! Device type, e.g. ocl::device_type::CPU for PoCL */
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	utl::Seconds prof( Dim const& ) override;
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	double ops( Dim const& ) override;
+
+	/*! Bytes moved by the kernel for the expected number of nonzeros. */
+	Traffic traffic( Dim const& ) const override;
+
+private :
+
+	std::string name(const std::string& kernel, double density) const
+	{
+		std::ostringstream oss;
+		oss << "spmm_" << kernel << "_" << utl::Type::type<Type>().name() <<  "_W" << W << "_D" << density;
+		return oss.str();
+	}
+
+	/*! Random M x K matrix with about density*M*K nonzeros. The same seed is used for every dimension. */
+	Matrix sparse( size_t M, size_t K ) const;
+
+
+	bool testing_;
+	double density_;
+	ocl::Platform platform_; /*! Platform of the device type given to the constructor. Initialized in the constructor */
+	ocl::Device   device_;   /*! The first Device is chosen. Initialized in the constructor */
+	ocl::Context  context_;  /*! Only one Context is created. Initialized in the constructor */
+	ocl::Queue    queue_;    /*! Only one Queue is created with the above Context and Device. Initialized in the constructor */
+	ocl::Program  program_;  /*! Program is created in the constructor but built in the prof() function with dimension parameters.*/
+	ocl::Kernel*  kernel_;   /*! Kernel is created in the constructor but built in the prof() function. */
+	Roofline<Type> roofline_; /*! Peaks of the device. Measured in the constructor */
+};
+
+
+template <class Type_, size_t W>
+SpmmPass<Type_,W>::SpmmPass(
+		const std::string& file,
+		const std::string& kernel,
+		double density,
+		const utl::Dim& start,
+		const utl::Dim& step,
+		const utl::Dim& end,
+		bool testing,
+		size_t iter,
+		DeviceType type) :
+	  Base(this->name(kernel, density), start, step, end, testing ? 1 : iter),
+	  testing_(testing),
+	  density_(density),
+	  platform_( type ),
+	  device_( platform_.device( type ) ),
+	  context_( device_ ),
+	  queue_( context_, device_, CL_QUEUE_PROFILING_ENABLE ),
+	  program_( context_, utl::type::Single | utl::type::Double ),
+	  kernel_(nullptr),
+	  roofline_( context_, queue_, type )
+{
+	if ( density <= 0.0 || density > 1.0 ) { throw std::runtime_error( "density should be in (0,1]." ); }
+
+	std::ifstream stream( file );
+	if ( !stream.is_open() ) { throw std::runtime_error("Failed opening file " + file);}
+	program_ << stream;
+
+	kernel_ = &program_.kernel(kernel, utl::Type::type<Type_>());
+	if ( kernel_ == nullptr ) { throw std::runtime_error( "kernel not valid" ); }
+}
+
+
+template <class Type_, size_t W>
+typename SpmmPass<Type_,W>::Matrix SpmmPass<Type_,W>::sparse( size_t M, size_t K ) const
+{
+	Matrix lhs = Rand (M, K);
+
+	std::mt19937 gen( 4711 );
+	std::bernoulli_distribution keep( density_ );
+	for ( size_t i = 0; i < M * K; ++i )
+		if ( !keep( gen ) ) lhs.data()[i] = Type( 0 );
+
+	return lhs;
+}
+
+
+/*! Profile function of the Pass.
+ *
+ * The sparse operand is always generated since its nonzero count determines the work.
+ * Besides the time which is handed to the PassManager, the footprint and upload time
+ * of the Csr arrays are written to stdout next to those of the dense matrix.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W>
+utl::Seconds SpmmPass<Type_,W>::prof( utl::Dim const& dim )
+{
+	  const size_t M = dim[0];
+	  const size_t N = dim[1];
+	  const size_t K = dim[2];
+
+	  if( N <= 0 ) throw std::runtime_error( "N should be greater 0." );
+	  if( M <= 0 ) throw std::runtime_error( "M should be greater 0." );
+
+	  std::ostringstream oss;
+	  oss << "-w -Werror" << " -D M=" << M << "u -D N=" << N << "u -D W=" << W << "u -D K=" << K << 'u';
+
+	  program_.setCompileOption( ocl::compile_option::FAST_MATH | ocl::compile_option::NO_SIGNED_ZERO | ocl::CompileOption( oss.str() ) );
+	  program_.build();
+	  if ( ! program_.isBuilt() ) { throw std::runtime_error( "program not built" ); }
+	  if ( ! kernel_->created() ) { throw std::runtime_error( "kernel not created" ); }
+
+	  kernel_->setWorkSize( W, 1, (N + W - 1) / W * W, M );
+
+	  const Matrix lhs = this->sparse( M, K );
+	  const Sparse csr( lhs );
+
+	  const size_t numResBytes = sizeof (Type) * M * N;
+	  const size_t numRhsBytes = sizeof (Type) * K * N;
+	  const size_t numDenseBytes = sizeof (Type) * M * K;
+
+	  // Empty buffers are not allowed, so colIdx and val get at least one element.
+	  ocl::Buffer bufRes   ( context_, numResBytes, ocl::Buffer::WriteOnly );
+	  ocl::Buffer bufRowPtr( context_, csr.rowPtrBytes(), ocl::Buffer::ReadOnly );
+	  ocl::Buffer bufColIdx( context_, std::max( csr.colIdxBytes(), sizeof (typename Sparse::Index) ), ocl::Buffer::ReadOnly );
+	  ocl::Buffer bufVal   ( context_, std::max( csr.valuesBytes(), sizeof (Type) ), ocl::Buffer::ReadOnly );
+	  ocl::Buffer bufRhs   ( context_, numRhsBytes, ocl::Buffer::ReadOnly );
+
+	  std::cout << "Running kernel with M=" << M << ", N=" << N << ", K=" << K << ", nnz=" << csr.nnz()
+				<< ", size[MB]=" << float(csr.bytes())/float(1<<20) << " (dense " << float(numDenseBytes)/float(1<<20) << ")" << std::endl;
+
+	  Timer::tic();
+	  bufRowPtr.write( queue_, 0u, csr.rowPtr(), csr.rowPtrBytes() );
+	  if ( csr.nnz() ) bufColIdx.write( queue_, 0u, csr.colIdx(), csr.colIdxBytes() );
+	  if ( csr.nnz() ) bufVal.write( queue_, 0u, csr.values(), csr.valuesBytes() );
+	  queue_.finish();
+	  Timer::toc();
+	  const double sparseUpload = Timer::elapsed().count();
+
+	  {
+		  ocl::Buffer bufLhs( context_, numDenseBytes, ocl::Buffer::ReadOnly );
+		  Timer::tic();
+		  bufLhs.write( queue_, 0u, lhs.data(), numDenseBytes );
+		  queue_.finish();
+		  Timer::toc();
+	  }
+	  const double denseUpload = Timer::elapsed().count();
+
+	  std::cout << "Upload[ms]: " << sparseUpload << " (dense " << denseUpload << ")" << std::endl;
+
+	  Matrix rhs;
+	  if(testing_){
+		  rhs = Rand (K, N);
+		  bufRhs.write( queue_, 0u, rhs.data(), numRhsBytes );
+	  }
+
+
+	  // Function which repeated iter_ times from the Passmanager.
+	  auto lambda = [](ocl::Kernel& kernel, ocl::Queue& queue, ocl::Buffer& bufRes,
+					   const ocl::Buffer& bufRowPtr, const ocl::Buffer& bufColIdx, const ocl::Buffer& bufVal, const ocl::Buffer& bufRhs)
+	  {
+		  kernel( queue, bufRes.id(), bufRowPtr.id(), bufColIdx.id(), bufVal.id(), bufRhs.id() );
+		  queue.finish();
+	  };
+
+	  auto t = this->profile(std::bind(lambda, std::ref(*kernel_), std::ref(queue_), std::ref(bufRes),
+									   std::cref(bufRowPtr), std::cref(bufColIdx), std::cref(bufVal), std::cref(bufRhs)), dim, roofline_);
+
+	  if( testing_ )
+	  {
+		  Matrix res = Zeros( M, N );
+		  bufRes.read( queue_, 0u, res.data(), numResBytes);
+
+		  verify( lhs, rhs, res ).report( std::cout );
+	  }
+
+
+	  program_.release();
+
+
+	  return t;
+}
+
+
+/*! Operation count function of the Pass.
+ *
+ * Only the multiplications with nonzeros count, so the expected number of nonzeros is used.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W>
+double SpmmPass<Type_,W>::ops( utl::Dim const& dim )
+{
+	  size_t const M = dim[0];
+	  size_t const N = dim[1];
+	  size_t const K = dim[2];
+
+	  return 2.0 * density_ * M * K * N;
+}
+
+
+/*! Traffic function of the Pass.
+ *
+ * Each of the N/W work-groups of a row reads the row's bounds and stages its nonzeros
+ * through local memory. Every thread then reads all nonzeros of the row from local
+ * memory and one element of B per nonzero.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W>
+Traffic SpmmPass<Type_,W>::traffic( utl::Dim const& dim ) const
+{
+	  size_t const M = dim[0];
+	  size_t const N = dim[1];
+	  size_t const K = dim[2];
+
+	  const double s      = sizeof (Type);
+	  const double i      = sizeof (typename Sparse::Index);
+	  const double nnz    = density_ * M * K;
+	  const double groups = double( (N + W - 1) / W );
+
+	  return Traffic( groups * ( 2.0 * M * i + nnz * (i + s) ) + nnz * N * s,
+					  s * M * N,
+					  groups * nnz * (i + s) + nnz * N * (i + s) );
+}
+
+#endif
@@ -0,0 +1,24 @@
+
+// Kernels for the recursive Strassen layer of strassen.h.
+//
+// All matrices are stored in row-major format and addressed as blocks of a parent
+// buffer: element (r,c) of a block lies at mem[off + r * ld + c], see view.h. M, N and K
+// are the dimensions of the leaf multiplication, rows and cols those of the addition.
+// The leaf multiplication is multiplyr_view of view.cl, which is prepended by strassen.h.
+
+
+// dst = src1 + alpha * src2. dst may be the same block as src1 or src2.
+template<class TYPE>
+__kernel void addr(unsigned int rows, unsigned int cols,
+                   __global TYPE *dst,  unsigned int dOff, unsigned int ldd,
+                   __global TYPE *src1, unsigned int off1, unsigned int ld1,
+                   __global TYPE *src2, unsigned int off2, unsigned int ld2,
+                   TYPE alpha)
+{
+    unsigned int col = get_global_id(0);
+    unsigned int row = get_global_id(1);
+
+    if(col >= cols || row >= rows) return;
+
+    dst[dOff + row * ldd + col] = src1[off1 + row * ld1 + col] + alpha * src2[off2 + row * ld2 + col];
+}
@@ -0,0 +1,352 @@
+#ifndef STRASSENPASS_H
+#define STRASSENPASS_H
+
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <istream>
+#include <vector>
+#include <cmath>
+
+#include <ocl_wrapper.h>
+#include <utl_utils.h>
+
+#include "roofline.h"
+#include "verify.h"
+#include "view.h"
+
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+/*! StrassenPass multiplies square row-major matrices with a host-side Strassen recursion.
+ *
+ * Each level splits the operands into quadrants and replaces the eight half-size
+ * products by seven, at the cost of 18 additions which run on the device with addr.
+ * The recursion stops after maxDepth levels or before the blocks get smaller than
+ * cutoff. Leaves are multiplied with multiplyr_view directly on the quadrant blocks,
+ * so no operand is copied. Each level allocates one workspace of 9 quadrants.
+ *
+ * Strassen trades accuracy for speed: its error bound grows by about a factor of 12
+ * per level (Higham, Accuracy and Stability of Numerical Algorithms, 23.2.2). In testing
+ * mode the tolerance is widened accordingly, and the reported ratio of error to the
+ * tolerance of the classical product shows what the levels cost.
+ *
+ * \param Type_ is the value type of the matrices. Here we use float or double.
+ * \param W is the tile size of the leaf kernel. Every leaf dimension must be a multiple of W.
+*/
+template <class Type_, size_t W>
+class StrassenPass : public RooflinePass
+{
+	using Base   = RooflinePass;
+	using Type   = Type_;
+	using Format = utl::row_major_tag;
+	using Rand   = utl::Rand  < Type, Format, utl::uniform_dist_tag >;
+	using Zeros  = utl::Zeros < Type, Format >;
+	using Matrix = utl::Matrix< Type, Format >;
+	using Dim    = utl::Dim;
+
+	/*! View of a device buffer. */
+	struct Block
+	{
+		cl_mem mem;
+		View   view;
+
+		Block quad( size_t i, size_t j, size_t h ) const { return Block{ mem, view.sub( i * h, j * h, h, h ) }; }
+	};
+
+public :
+
+	StrassenPass() = delete;
+	StrassenPass(const StrassenPass&) = default;
+	StrassenPass(StrassenPass&&) = default;
+	~StrassenPass() = default;
+
+
+	/*! This is the constructor one should use to initialize the platform. */
+	StrassenPass(const std::string& filename,   /*! Name of the *.cl file */
+				 size_t maxDepth,               /*! Maximal number of Strassen levels. 0 calls the leaf kernel only */
+				 size_t cutoff,                 /*! Blocks smaller than cutoff are not split any further */
+				 const Dim& start,              /*! First dimension e.g. Dim(1024,1024,1024). M, N and K must be equal */
+				 const Dim& step,               /*! Step dimension e.g. Dim(1024,1024,1024) such that this pass iterates from first to last dimension */
+				 const Dim& end,                /*! Last dimension e.g. Dim(8192,8192,8192). M, N and K must be equal */
+				 bool testing = false,          /*! If true, verifies the gpu result, see verify.h */
+				 size_t iter = 10,              /*! Number of kernel iterations */
+				 DeviceType type = ocl::device_type::GPU); /*! Device type, e.g. ocl::device_type::CPU for PoCL */
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	utl::Seconds prof( Dim const& ) override;
+
+	/*! This function needs to be defined so that it can be called from the pass manager. */
+	double ops( Dim const& ) override;
+
+	/*! Bytes moved by all additions and leaf multiplications. */
+	Traffic traffic( Dim const& ) const override;
+
+private :
+
+	std::string name(size_t maxDepth, size_t cutoff) const
+	{
+		std::ostringstream oss;
+		oss << "strassen_" << utl::Type::type<Type>().name() <<  "_B" << W << "_D" << maxDepth << "_C" << cutoff;
+		return oss.str();
+	}
+
+	/*! Number of levels used for an n x n product. */
+	size_t depth( size_t n ) const;
+
+	/*! Traffic of an n x n product with the given number of levels. */
+	static Traffic traffic( size_t n, size_t levels );
+
+	/*! dst = src1 + alpha * src2 for h x h blocks. */
+	void add( const Block& dst, const Block& src1, const Block& src2, Type alpha, size_t h );
+
+	/*! C = A * B for n x n blocks, where level indexes the workspace. */
+	void multiply( const Block& C, const Block& A, const Block& B, size_t n, size_t level );
+
+
+	bool testing_;
+	size_t maxDepth_;
+	size_t cutoff_;
+	ocl::Platform platform_; /*! Platform of the device type given to the constructor. Initialized in the constructor */
+	ocl::Device   device_;   /*! The first Device is chosen. Initialized in the constructor */
+	ocl::Context  context_;  /*! Only one Context is created. Initialized in the constructor */
+	ocl::Queue    queue_;    /*! Only one Queue is created with the above Context and Device. Initialized in the constructor */
+	ocl::Program  program_;  /*! Program is created in the constructor but built in the prof() function with dimension parameters.*/
+	ocl::Kernel*  kernel_;   /*! Leaf multiplication kernel. */
+	ocl::Kernel*  add_;      /*! Addition kernel. */
+	std::vector<std::unique_ptr<ocl::Buffer>> workspace_; /*! One buffer of 9 quadrants per level. Allocated in the prof() function. */
+	Roofline<Type> roofline_; /*! Peaks of the device. Measured in the constructor */
+};
+
+
+template <class Type_, size_t W>
+StrassenPass<Type_,W>::StrassenPass(
+		const std::string& file,
+		size_t maxDepth,
+		size_t cutoff,
+		const utl::Dim& start,
+		const utl::Dim& step,
+		const utl::Dim& end,
+		bool testing,
+		size_t iter,
+		DeviceType type) :
+	  Base(this->name(maxDepth, cutoff), start, step, end, testing ? 1 : iter),
+	  testing_(testing),
+	  maxDepth_(maxDepth),
+	  cutoff_(cutoff),
+	  platform_( type ),
+	  device_( platform_.device( type ) ),
+	  context_( device_ ),
+	  queue_( context_, device_, CL_QUEUE_PROFILING_ENABLE ),
+	  program_( context_, utl::type::Single | utl::type::Double ),
+	  kernel_(nullptr),
+	  add_(nullptr),
+	  roofline_( context_, queue_, type )
+{
+	std::ifstream stream( file );
+	if ( !stream.is_open() ) { throw std::runtime_error("Failed opening file " + file);}
+	std::ostringstream source;
+	source << viewSource( file ) << stream.rdbuf();
+	program_ << source.str();
+
+	kernel_ = &program_.kernel("multiplyr_view", utl::Type::type<Type_>());
+	if ( kernel_ == nullptr ) { throw std::runtime_error( "kernel not valid" ); }
+
+	add_ = &program_.kernel("addr", utl::Type::type<Type_>());
+	if ( add_ == nullptr ) { throw std::runtime_error( "kernel not valid" ); }
+}
+
+
+template <class Type_, size_t W>
+size_t StrassenPass<Type_,W>::depth( size_t n ) const
+{
+	size_t d = 0;
+	while ( d < maxDepth_ && (n >> (d + 1)) >= cutoff_ && (n >> (d + 1)) % W == 0 && (n >> d) % 2 == 0 ) ++d;
+	return d;
+}
+
+
+template <class Type_, size_t W>
+void StrassenPass<Type_,W>::add( const Block& dst, const Block& src1, const Block& src2, Type alpha, size_t h )
+{
+	add_->setWorkSize( W, W, h, h );
+	(*add_)( queue_, unsigned(h), unsigned(h),
+			 dst.mem,  unsigned(dst.view.offset),  unsigned(dst.view.ld),
+			 src1.mem, unsigned(src1.view.offset), unsigned(src1.view.ld),
+			 src2.mem, unsigned(src2.view.offset), unsigned(src2.view.ld),
+			 alpha );
+}
+
+
+template <class Type_, size_t W>
+void StrassenPass<Type_,W>::multiply( const Block& C, const Block& A, const Block& B, size_t n, size_t level )
+{
+	if ( level == workspace_.size() )
+	{
+		(*kernel_)( queue_,
+					C.mem, unsigned(C.view.offset), unsigned(C.view.ld),
+					A.mem, unsigned(A.view.offset), unsigned(A.view.ld),
+					B.mem, unsigned(B.view.offset), unsigned(B.view.ld),
+					Type(0) );
+		return;
+	}
+
+	const size_t h = n / 2;
+
+	const Block A11 = A.quad(0,0,h), A12 = A.quad(0,1,h), A21 = A.quad(1,0,h), A22 = A.quad(1,1,h);
+	const Block B11 = B.quad(0,0,h), B12 = B.quad(0,1,h), B21 = B.quad(1,0,h), B22 = B.quad(1,1,h);
+	const Block C11 = C.quad(0,0,h), C12 = C.quad(0,1,h), C21 = C.quad(1,0,h), C22 = C.quad(1,1,h);
+
+	// Workspace of this level: two operand sums and the seven products, each h x h.
+	const cl_mem mem = workspace_[level]->id();
+	auto slot = [&]( size_t i ) { return Block{ mem, View( i * h * h, h, h, h ) }; };
+	const Block T1 = slot(0), T2 = slot(1);
+	const Block P1 = slot(2), P2 = slot(3), P3 = slot(4), P4 = slot(5), P5 = slot(6), P6 = slot(7), P7 = slot(8);
+
+	add( T1, A11, A22,  1, h ); add( T2, B11, B22,  1, h ); multiply( P1, T1,  T2,  h, level + 1 );
+	add( T1, A21, A22,  1, h );                             multiply( P2, T1,  B11, h, level + 1 );
+	add( T2, B12, B22, -1, h );                             multiply( P3, A11, T2,  h, level + 1 );
+	add( T2, B21, B11, -1, h );                             multiply( P4, A22, T2,  h, level + 1 );
+	add( T1, A11, A12,  1, h );                             multiply( P5, T1,  B22, h, level + 1 );
+	add( T1, A21, A11, -1, h ); add( T2, B11, B12,  1, h ); multiply( P6, T1,  T2,  h, level + 1 );
+	add( T1, A12, A22, -1, h ); add( T2, B21, B22,  1, h ); multiply( P7, T1,  T2,  h, level + 1 );
+
+	// C11 = P1 + P4 - P5 + P7
+	add( C11, P1,  P4,  1, h ); add( C11, C11, P5, -1, h ); add( C11, C11, P7, 1, h );
+	// C12 = P3 + P5
+	add( C12, P3,  P5,  1, h );
+	// C21 = P2 + P4
+	add( C21, P2,  P4,  1, h );
+	// C22 = P1 - P2 + P3 + P6
+	add( C22, P1,  P2, -1, h ); add( C22, C22, P3,  1, h ); add( C22, C22, P6, 1, h );
+}
+
+
+/*! Profile function of the Pass.
+ *
+ * The leaf kernel is compiled for the leaf size n / 2^depth. All launches of one
+ * product are enqueued in order on the single queue, so only the last one is waited for.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W>
+utl::Seconds StrassenPass<Type_,W>::prof( utl::Dim const& dim )
+{
+	  const size_t n = dim[0];
+
+	  if( n <= 0 ) throw std::runtime_error( "N should be greater 0." );
+	  if( dim[1] != n || dim[2] != n ) throw std::runtime_error( "M, N and K should be equal." );
+
+	  const size_t levels = this->depth( n );
+	  const size_t leaf   = n >> levels;
+
+	  if( leaf % W ) throw std::runtime_error( "leaf size should be a multiple of W." );
+
+	  std::ostringstream oss;
+	  oss << "-w -Werror" << " -D M=" << leaf << "u -D N=" << leaf << "u -D W=" << W << "u -D K=" << leaf << 'u';
+
+	  program_.setCompileOption( ocl::compile_option::FAST_MATH | ocl::compile_option::NO_SIGNED_ZERO | ocl::CompileOption( oss.str() ) );
+	  program_.build();
+	  if ( ! program_.isBuilt() ) { throw std::runtime_error( "program not built" ); }
+	  if ( ! kernel_->created() ) { throw std::runtime_error( "kernel not created" ); }
+
+	  kernel_->setWorkSize( W, W, leaf, leaf );
+
+	  const size_t numBytes = sizeof (Type) * n * n;
+
+	  ocl::Buffer bufRes( context_, numBytes, ocl::Buffer::ReadWrite );
+	  ocl::Buffer bufLhs( context_, numBytes, ocl::Buffer::ReadOnly );
+	  ocl::Buffer bufRhs( context_, numBytes, ocl::Buffer::ReadOnly );
+
+	  workspace_.clear();
+	  for ( size_t l = 1; l <= levels; ++l )
+	  {
+		  const size_t h = n >> l;
+		  workspace_.emplace_back( new ocl::Buffer( context_, 9 * sizeof (Type) * h * h, ocl::Buffer::ReadWrite ) );
+	  }
+
+	  std::cout << "Running kernel with M=N=K=" << n << ", levels=" << levels << ", leaf=" << leaf << ", size[MB]=" << float(numBytes)/float(1<<20) << std::endl;
+
+	  Matrix lhs;
+	  Matrix rhs;
+	  if(testing_){
+		  lhs = Rand (n, n);
+		  rhs = Rand (n, n);
+		  bufLhs.write( queue_, 0u, lhs.data(), numBytes );
+		  bufRhs.write( queue_, 0u, rhs.data(), numBytes );
+	  }
+
+	  // Function which repeated iter_ times from the Passmanager.
+	  auto lambda = [this, n](const ocl::Buffer& bufRes, const ocl::Buffer& bufLhs, const ocl::Buffer& bufRhs)
+	  {
+		  const Block C{ bufRes.id(), View( n, n ) }, A{ bufLhs.id(), View( n, n ) }, B{ bufRhs.id(), View( n, n ) };
+		  this->multiply( C, A, B, n, 0 );
+		  queue_.finish();
+	  };
+
+	  auto t = this->profile(std::bind(lambda, std::cref(bufRes), std::cref(bufLhs), std::cref(bufRhs)), dim, roofline_);
+
+	  if( testing_ )
+	  {
+		  Matrix res = Zeros( n, n );
+		  bufRes.read( queue_, 0u, res.data(), numBytes);
+
+		  const Verification v = verify( lhs, rhs, res, 4.0 * std::pow( 12.0, double( levels ) ) );
+		  v.report( std::cout );
+		  std::cout << "Error relative to the classical tolerance: " << v.maxRatio * std::pow( 12.0, double( levels ) ) << std::endl;
+	  }
+
+	  workspace_.clear();
+	  program_.release();
+
+
+	  return t;
+}
+
+
+/*! Operation count function of the Pass.
+ *
+ * The classical count is used on purpose, so the reported rate is comparable to the
+ * tiled kernels and exceeds their peak once the saved multiplications pay off.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W>
+double StrassenPass<Type_,W>::ops( utl::Dim const& dim )
+{
+	  size_t const M = dim[0];
+	  size_t const N = dim[1];
+	  size_t const K = dim[2];
+
+	  return double(M) * N * (K + K - 1u);
+}
+
+
+/*! Traffic function of the Pass.
+ *
+ * \param dim Dimension which is between the first and the last.
+*/
+template <class Type_, size_t W>
+Traffic StrassenPass<Type_,W>::traffic( utl::Dim const& dim ) const
+{
+	  return traffic( dim[0], this->depth( dim[0] ) );
+}
+
+
+/*! Every level runs 18 additions, each reading two and writing one h x h block, and seven products of half size. */
+template <class Type_, size_t W>
+Traffic StrassenPass<Type_,W>::traffic( size_t n, size_t levels )
+{
+	  if ( levels == 0 ) return tiledTraffic<Type>( n, n, n, W );
+
+	  const double h = n / 2;
+	  const double s = sizeof (Type);
+
+	  Traffic t( s * 18.0 * 2.0 * h * h, s * 18.0 * h * h );
+	  t += traffic( n / 2, levels - 1 ) * 7.0;
+	  return t;
+}
+
+#endif
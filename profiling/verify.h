@@ -0,0 +1,269 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <cmath>
+
+#include <utl_utils.h>
+
+
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////
+
+/*! Number of failed checks reported by this process. The check driver returns it as exit status. */
+inline std::atomic<size_t>& failedChecks()
+{
+	static std::atomic<size_t> count( 0 );
+	return count;
+}
+
+
+/*! Verification of a product C = A * B with A of size M x K and B of size K x N.
+ *
+ * Element (i,j) passes if |C(i,j) - R(i,j)| <= factor * K * eps * (|A| |B|)(i,j), where R is
+ * a reference computed in double precision, eps the machine epsilon of the value type and
+ * |.| the element-wise absolute value. This is the standard error bound of a dot product of
+ * length K, so the tolerance grows with K instead of requiring exact results.
+ *
+ * Full computes R and |A| |B| with blocked, multithreaded products. Freivalds multiplies
+ * both sides with random +-1 vectors x, which costs O(M*K + K*N + M*N) per round. Row i of
+ * C x is compared against tol * sum_k |A(i,k)| * |(B x)(k)|, the bound of the same products
+ * which A (B x) sums, so the tolerance follows the contribution of the row itself. In
+ * addition SAMPLES random rows are compared element by element as in Full. Auto chooses
+ * Full up to about 2^27 multiply-adds.
+*/
+struct Verification
+{
+	enum class Method { Auto, Full, Freivalds };
+
+	static constexpr size_t SAMPLES = 16; /*! Rows compared element by element by Freivalds */
+
+	Method method;      /*! Method which was used, never Auto. Freivalds if any merged result used it */
+	size_t checked;     /*! Number of compared values */
+	size_t failures;    /*! Number of values outside the tolerance */
+	double maxError;    /*! Maximal absolute error */
+	double maxRatio;    /*! Maximal ratio of error to tolerance, passes if <= 1 */
+	size_t worst;       /*! Row of the value with the maximal ratio */
+
+	explicit Verification( Method method = Method::Full ) : method(method), checked(0), failures(0), maxError(0), maxRatio(0), worst(0) {}
+
+	bool passed() const { return failures == 0; }
+
+	/*! Adds one value with the given error and bound. i is the row reported as worst. */
+	void add( size_t i, double error, double bound )
+	{
+		const double ratio = bound > 0 ? error / bound : ( error > 0 ? std::numeric_limits<double>::infinity() : 0.0 );
+		++checked;
+		if ( ratio > 1.0 ) ++failures;
+		if ( ratio > maxRatio ) { maxRatio = ratio; worst = i; }
+		maxError = std::max( maxError, error );
+	}
+
+	/*! Merges the result of another verification, e.g. of another job or thread. */
+	Verification& operator+=( const Verification& other )
+	{
+		if ( other.checked > 0 && other.method == Method::Freivalds ) method = Method::Freivalds;
+		if ( other.maxRatio > maxRatio ) { maxRatio = other.maxRatio; worst = other.worst; }
+		maxError = std::max( maxError, other.maxError );
+		checked  += other.checked;
+		failures += other.failures;
+		return *this;
+	}
+
+	/*! Writes a one-line summary. A failure is counted in failedChecks(). */
+	void report( std::ostream& os ) const
+	{
+		if ( !passed() ) ++failedChecks();
+
+		os << "Verification (" << ( method == Method::Freivalds ? "freivalds" : "full" ) << "): "
+		   << ( passed() ? "passed" : "FAILED" )
+		   << ", checked=" << checked << ", failures=" << failures
+		   << ", max error=" << maxError << ", max error/tolerance=" << maxRatio;
+		if ( !passed() ) os << " in row " << worst;
+		os << std::endl;
+	}
+};
+
+
+/*! Calls f(begin, end) for disjoint ranges covering [0,n) on all hardware threads. */
+template <class F>
+void parallelFor( size_t n, F f )
+{
+	const size_t threads = std::max<size_t>( 1, std::min<size_t>( std::thread::hardware_concurrency(), (n + 15) / 16 ) );
+	const size_t chunk = (n + threads - 1) / threads;
+
+	std::vector<std::thread> pool;
+	for ( size_t begin = 0; begin < n; begin += chunk )
+		pool.emplace_back( f, begin, std::min( n, begin + chunk ) );
+	for ( auto& thread : pool ) thread.join();
+}
+
+
+/*! Copies a rows x cols matrix into a row-major double matrix. */
+template <class Type>
+std::vector<double> toRowMajor( const Type* data, bool rowMajor, size_t rows, size_t cols )
+{
+	std::vector<double> out( rows * cols );
+	for ( size_t i = 0; i < rows; ++i )
+		for ( size_t j = 0; j < cols; ++j )
+			out[i * cols + j] = double( data[rowMajor ? i * cols + j : j * rows + i] );
+	return out;
+}
+
+
+/*! Computes R = A * B for row-major double matrices with a blocked product on all hardware threads. R is row-major. */
+inline std::vector<double> product( const std::vector<double>& a, const std::vector<double>& b, size_t M, size_t N, size_t K )
+{
+	constexpr size_t IB = 16, KB = 64, NB = 256;
+
+	std::vector<double> r( M * N, 0.0 );
+
+	// Threads own IB rows at a time. Blocks of KB x NB elements of B stay in cache
+	// while they are applied to all IB rows.
+	parallelFor( (M + IB - 1) / IB, [&]( size_t begin, size_t end )
+	{
+		for ( size_t ib = begin * IB; ib < std::min( M, end * IB ); ib += IB )
+			for ( size_t kb = 0; kb < K; kb += KB )
+				for ( size_t jb = 0; jb < N; jb += NB )
+					for ( size_t i = ib; i < std::min( M, ib + IB ); ++i )
+						for ( size_t k = kb; k < std::min( K, kb + KB ); ++k )
+						{
+							const double x = a[i * K + k];
+							const double* brow = &b[k * N];
+							double* rrow = &r[i * N];
+							for ( size_t j = jb; j < std::min( N, jb + NB ); ++j ) rrow[j] += x * brow[j];
+						}
+	});
+	return r;
+}
+
+
+/*! Computes the row-major double reference of A * B, see product(). */
+template <class Type>
+std::vector<double> reference( const Type* A, bool aRowMajor, const Type* B, bool bRowMajor, size_t M, size_t N, size_t K )
+{
+	return product( toRowMajor( A, aRowMajor, M, K ), toRowMajor( B, bRowMajor, K, N ), M, N, K );
+}
+
+
+/*! Compares n = ref.size() values. Value i passes if |res[i] - ref[i]| <= tol * scale[i]. */
+template <class Type>
+Verification compare( const Type* res, const std::vector<double>& ref, const std::vector<double>& scale, double tol )
+{
+	Verification result;
+	for ( size_t i = 0; i < ref.size(); ++i )
+		result.add( i, std::fabs( double( res[i] ) - ref[i] ), tol * scale[i] );
+	return result;
+}
+
+
+/*! Verifies C = A * B. Each matrix is given by its data and whether it is stored in row-major format.
+ *
+ * \param factor Scales the tolerance. 4 covers the reordered summation of fast-math kernels.
+*/
+template <class Type>
+Verification verify( const Type* A, bool aRowMajor,
+					 const Type* B, bool bRowMajor,
+					 const Type* C, bool cRowMajor,
+					 size_t M, size_t N, size_t K,
+					 double factor = 4.0,
+					 Verification::Method method = Verification::Method::Auto,
+					 size_t rounds = 2 )
+{
+	const double eps = std::is_floating_point<Type>::value ? double( std::numeric_limits<Type>::epsilon() ) : 0.0;
+	const double tol = factor * double( K ) * eps;
+
+	if ( method == Verification::Method::Auto )
+		method = double( M ) * N * K <= double( size_t(1) << 27 ) ? Verification::Method::Full : Verification::Method::Freivalds;
+
+	const std::vector<double> a = toRowMajor( A, aRowMajor, M, K );
+	const std::vector<double> b = toRowMajor( B, bRowMajor, K, N );
+	auto const c = [&]( size_t i, size_t j ) { return double( C[cRowMajor ? i * N + j : j * M + i] ); };
+
+	Verification result( method );
+	std::mutex mutex;
+
+	std::vector<double> absA( a.size() ), absB( b.size() );
+	std::transform( a.begin(), a.end(), absA.begin(), []( double v ) { return std::fabs( v ); } );
+	std::transform( b.begin(), b.end(), absB.begin(), []( double v ) { return std::fabs( v ); } );
+
+	if ( method == Verification::Method::Full )
+	{
+		const std::vector<double> r = product( a, b, M, N, K );
+		const std::vector<double> bound = product( absA, absB, M, N, K );
+
+		parallelFor( M, [&]( size_t begin, size_t end )
+		{
+			Verification local( method );
+			for ( size_t i = begin; i < end; ++i )
+				for ( size_t j = 0; j < N; ++j )
+					local.add( i, std::fabs( c( i, j ) - r[i * N + j] ), tol * bound[i * N + j] );
+			std::lock_guard<std::mutex> lock( mutex );
+			result += local;
+		});
+		return result;
+	}
+
+	std::mt19937 gen( 4711 );
+	std::bernoulli_distribution sign;
+
+	// A few random rows are checked element by element, which catches single wrong elements for sure.
+	std::uniform_int_distribution<size_t> pick( 0, M - 1 );
+	for ( size_t s = 0; s < std::min( M, Verification::SAMPLES ); ++s )
+	{
+		const size_t i = pick( gen );
+		std::vector<double> r( N, 0.0 ), bound( N, 0.0 );
+		for ( size_t k = 0; k < K; ++k )
+			for ( size_t j = 0; j < N; ++j ) { r[j] += a[i * K + k] * b[k * N + j]; bound[j] += absA[i * K + k] * absB[k * N + j]; }
+		for ( size_t j = 0; j < N; ++j ) result.add( i, std::fabs( c( i, j ) - r[j] ), tol * bound[j] );
+	}
+
+	// Freivalds: compare C x with A (B x) for random x of +-1. Row i of A (B x) sums the
+	// products A(i,k) * (B x)(k), whose absolute values bound the error of the row.
+	for ( size_t r = 0; r < rounds; ++r )
+	{
+		std::vector<double> x( N ), y( K, 0.0 );
+		for ( auto& v : x ) v = sign( gen ) ? 1.0 : -1.0;
+		for ( size_t k = 0; k < K; ++k ) for ( size_t j = 0; j < N; ++j ) y[k] += b[k * N + j] * x[j];
+
+		parallelFor( M, [&]( size_t begin, size_t end )
+		{
+			Verification local( method );
+			for ( size_t i = begin; i < end; ++i )
+			{
+				double z = 0, w = 0, bound = 0;
+				for ( size_t k = 0; k < K; ++k ) { z += a[i * K + k] * y[k]; bound += absA[i * K + k] * std::fabs( y[k] ); }
+				for ( size_t j = 0; j < N; ++j ) w += c( i, j ) * x[j];
+				local.add( i, std::fabs( w - z ), tol * bound );
+			}
+			std::lock_guard<std::mutex> lock( mutex );
+			result += local;
+		});
+	}
+	return result;
+}
+
+
+/*! Verifies res = lhs * rhs for matrices of the same format. */
+template <class Type, class Format>
+Verification verify( const utl::Matrix<Type, Format>& lhs,
+					 const utl::Matrix<Type, Format>& rhs,
+					 const utl::Matrix<Type, Format>& res,
+					 double factor = 4.0,
+					 Verification::Method method = Verification::Method::Auto )
+{
+	constexpr bool rowMajor = std::is_same<Format, utl::row_major_tag>::value;
+	return verify( lhs.data(), rowMajor, rhs.data(), rowMajor, res.data(), rowMajor,
+				   lhs.rows(), rhs.cols(), lhs.cols(), factor, method );
+}
+
+#endif
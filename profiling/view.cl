@@ -0,0 +1,44 @@
+// Kernels on strided views, see view.h. Passes which need them together with kernels
+// of their own prepend this file to their program, see viewSource().
+
+// multiplyr on strided views, see view.h: element (r,c) of a view lies at off + r * ld + c
+// of its buffer. dst = src1 * src2 + beta * dst, where dst is M x N, src1 M x K and src2 K x N.
+// So blocks, panels and slices of parent buffers are multiplied in place, and with beta = 1
+// a panel update accumulates into dst. dst is not read if beta is 0.
+template<class TYPE>
+__kernel void multiplyr_view(__global TYPE *dst,  unsigned int dOff, unsigned int ldd,
+                             __global TYPE *src1, unsigned int off1, unsigned int ld1,
+                             __global TYPE *src2, unsigned int off2, unsigned int ld2,
+                             TYPE beta)
+{
+    __local TYPE As[W][W];
+    __local TYPE Bs[W][W];
+
+    unsigned int g_col = get_group_id(0);
+    unsigned int g_row = get_group_id(1);
+
+    unsigned int l_col = get_local_id(0);
+    unsigned int l_row = get_local_id(1);
+
+    if(g_col >= N / W || g_row >= M / W || l_col >= W || l_row >= W)
+        return;
+
+    TYPE c_value = 0;
+
+    for (int j = 0; j < (K / W); ++j) {
+        As[l_row][l_col] = src1[off1 + (g_row * W + l_row) * ld1 + (j * W + l_col)];
+        Bs[l_row][l_col] = src2[off2 + (j * W + l_row) * ld2 + (g_col * W + l_col)];
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int e = 0; e < W; ++e) {
+            c_value += As[l_row][e] * Bs[e][l_col];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    const unsigned int index = dOff + (g_row * W + l_row) * ldd + g_col * W + l_col;
+    if(beta != 0)
+        c_value += beta * dst[index];
+    dst[index] = c_value;
+}
@@ -0,0 +1,70 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <stdexcept>
+#include <cstddef>
+#include <string>
+#include <sstream>
+#include <fstream>
+
+
+/*! Strided view of a row-major matrix within a parent buffer.
+ *
+ * Element (r,c) of the view lies at offset + r * ld + c of the parent, so blocks,
+ * panels and slices of a parent can be handed to the *_view kernels without copies.
+ * The kernels take each view as the three arguments offset, ld and the buffer itself;
+ * rows and cols are given by the compile-time dimensions M, N and K.
+*/
+struct View
+{
+	size_t offset; /*! Index of element (0,0) within the parent buffer. */
+	size_t rows;   /*! Number of rows of the view. */
+	size_t cols;   /*! Number of columns of the view. */
+	size_t ld;     /*! Leading dimension, i.e. the distance between two rows in the parent buffer. */
+
+	View() : offset(0), rows(0), cols(0), ld(0) {}
+
+	/*! View of a dense rows x cols matrix. */
+	View(size_t rows, size_t cols) : offset(0), rows(rows), cols(cols), ld(cols) {}
+
+	View(size_t offset, size_t rows, size_t cols, size_t ld) : offset(offset), rows(rows), cols(cols), ld(ld)
+	{
+		if ( ld < cols ) { throw std::runtime_error( "leading dimension smaller than column count" ); }
+	}
+
+	/*! View of rows x cols elements starting at (row,col) of this view. */
+	View sub(size_t row, size_t col, size_t rows, size_t cols) const
+	{
+		if ( row + rows > this->rows || col + cols > this->cols ) { throw std::runtime_error( "sub view out of range" ); }
+		return View( index( row, col ), rows, cols, ld );
+	}
+
+	/*! Index of element (r,c) within the parent buffer. */
+	size_t index(size_t r, size_t c) const { return offset + r * ld + c; }
+
+	/*! Number of parent elements from element (0,0) to the last element of the view. */
+	size_t span() const { return rows == 0 || cols == 0 ? 0 : (rows - 1) * ld + cols; }
+
+	/*! True if the rows of the view follow each other without gaps. */
+	bool contiguous() const { return ld == cols; }
+};
+
+
+/*! Source of view.cl with the *_view kernels.
+ *
+ * view.cl is looked up in the directory of file, the *.cl file of a pass. So passes with
+ * kernels of their own prepend it to their program instead of keeping copies.
+*/
+inline std::string viewSource( const std::string& file )
+{
+	const size_t slash = file.find_last_of( '/' );
+	const std::string path = ( slash == std::string::npos ? std::string() : file.substr( 0, slash + 1 ) ) + "view.cl";
+
+	std::ifstream stream( path );
+	if ( !stream.is_open() ) { throw std::runtime_error("Failed opening file " + path);}
+	std::ostringstream oss;
+	oss << stream.rdbuf();
+	return oss.str();
+}
+
+#endif